@@ -0,0 +1,235 @@
+/*
+ * KUnit tests for the Samsung backlight driver
+ *
+ * These are included at the end of samsung-backlight.c when it is built with
+ * CONFIG_SAMSUNG_BACKLIGHT_KUNIT_TEST=y, so they can get at the static
+ * functions in there.  Every test gets a loopback backlight of its own, so no
+ * Samsung hardware is needed.  On other machines the tests borrow the
+ * original model for as long as they run.
+ *
+ * Out of tree, build with CONFIG_SAMSUNG_BACKLIGHT_KUNIT_TEST=y and load the
+ * module, the results end up in the kernel log.  With the driver copied into
+ * a kernel tree, see Kconfig, kunit.py can run them as well:
+ *
+ *	./tools/testing/kunit/kunit.py run --arch=x86_64 \
+ *		--kunitconfig=drivers/video/backlight/samsung
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#include <kunit/test.h>
+
+#define SAMSUNG_TEST_LOOPS	1000
+/* well clear of the indexes probe hands out */
+#define SAMSUNG_TEST_INDEX	1000
+
+struct samsung_test {
+	struct samsung_bl	*bl;
+	const struct samsung_model *model;
+	unsigned int		coalesce_ms;
+};
+
+static int samsung_test_init(struct kunit *test)
+{
+	struct samsung_test *priv;
+	int retval;
+
+#ifndef CONFIG_SAMSUNG_BACKLIGHT_LOOPBACK
+	kunit_skip(test, "built without the loopback backend");
+#endif
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+
+	wait_for_device_probe();
+	if (IS_ERR_OR_NULL(samsung_device))
+		kunit_skip(test, "driver did not load");
+
+	/* nothing matched this machine, pretend it is the original one */
+	priv->model = model;
+	if (!model) {
+		model = &samsung_legacy;
+		retval = setup_model();
+		if (retval)
+			model = NULL;
+		KUNIT_ASSERT_EQ(test, retval, 0);
+	}
+
+	retval = samsung_bl_create(samsung_device, NULL, SAMSUNG_TEST_INDEX);
+	if (retval)
+		model = priv->model;
+	KUNIT_ASSERT_EQ(test, retval, 0);
+
+	mutex_lock(&samsung_lock);
+	priv->bl = list_last_entry(&samsung_devices, struct samsung_bl, list);
+	mutex_unlock(&samsung_lock);
+
+	/* every write goes straight to the register */
+	priv->bl->ramp_ms = 0;
+	priv->coalesce_ms = coalesce_ms;
+	coalesce_ms = 0;
+
+	test->priv = priv;
+	return 0;
+}
+
+static void samsung_test_exit(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+
+	if (!priv)
+		return;
+
+	coalesce_ms = priv->coalesce_ms;
+	mutex_lock(&samsung_lock);
+	list_del(&priv->bl->list);
+	mutex_unlock(&samsung_lock);
+	samsung_bl_destroy(priv->bl);
+	model = priv->model;
+}
+
+/* what the register holds and what we read back for a level we just set */
+static void samsung_test_check_level(struct kunit *test, struct samsung_bl *bl,
+				     unsigned int level)
+{
+	u8 hw = bl->loopback_regs[bl->offset];
+
+	KUNIT_EXPECT_EQ(test, hw, user_to_hw(level));
+	KUNIT_EXPECT_GE(test, hw, MIN_HW);
+
+	/* and not just out of the shadow register */
+	invalidate_hw(bl);
+	KUNIT_EXPECT_EQ(test, read_brightness(bl), level);
+}
+
+/* every level written through the backlight core comes back the same */
+static void samsung_test_update_status(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+	struct samsung_bl *bl = priv->bl;
+	unsigned int level;
+
+	for (level = 0; level < levels; level++) {
+		KUNIT_EXPECT_EQ(test,
+				backlight_device_set_brightness(bl->bd, level),
+				0);
+		samsung_test_check_level(test, bl, level);
+	}
+}
+
+/* and so does every level the driver sets on its own */
+static void samsung_test_set_brightness(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+	struct samsung_bl *bl = priv->bl;
+	unsigned int level;
+
+	for (level = levels; level-- > 0; ) {
+		set_brightness(bl, level);
+		samsung_test_check_level(test, bl, level);
+	}
+}
+
+/*
+ * What the backlight core reads back is the level that was set, and a change
+ * behind our back shows up there too, while the brightness file stays put.
+ */
+static void samsung_test_get_brightness(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+	struct samsung_bl *bl = priv->bl;
+	struct backlight_device *bd = bl->bd;
+	unsigned int level;
+
+	for (level = 0; level < levels; level++) {
+		backlight_device_set_brightness(bd, level);
+		KUNIT_EXPECT_EQ(test, bd->ops->get_brightness(bd), level);
+	}
+
+	backlight_device_set_brightness(bd, 0);
+	bl->loopback_regs[bl->offset] = user_to_hw(levels - 1);
+	invalidate_hw(bl);
+	KUNIT_EXPECT_EQ(test, bd->ops->get_brightness(bd), levels - 1);
+	KUNIT_EXPECT_EQ(test, bd->props.brightness, 0);
+}
+
+/* writing the same level again, or reading it, does not touch the hardware */
+static void samsung_test_shadow(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+	struct samsung_bl *bl = priv->bl;
+	unsigned long writes;
+	unsigned long reads;
+
+	set_brightness(bl, 1);
+	writes = stat_read(bl, config_writes);
+	reads = stat_read(bl, config_reads);
+
+	set_brightness(bl, 1);
+	KUNIT_EXPECT_EQ(test, read_brightness(bl), 1);
+	KUNIT_EXPECT_EQ(test, stat_read(bl, config_writes), writes);
+	KUNIT_EXPECT_EQ(test, stat_read(bl, config_reads), reads);
+}
+
+/*
+ * What a read costs with and without the shadow register, and what a write
+ * costs.  The timings depend on the machine and only end up in the log, the
+ * number of register accesses is what is checked.
+ */
+static void samsung_test_cost(struct kunit *test)
+{
+	struct samsung_test *priv = test->priv;
+	struct samsung_bl *bl = priv->bl;
+	unsigned long reads;
+	u64 cached, uncached, written;
+	ktime_t start;
+	int i;
+
+	read_brightness(bl);
+	reads = stat_read(bl, config_reads);
+
+	start = ktime_get();
+	for (i = 0; i < SAMSUNG_TEST_LOOPS; i++)
+		read_brightness(bl);
+	cached = ktime_to_ns(ktime_sub(ktime_get(), start));
+	KUNIT_EXPECT_EQ(test, stat_read(bl, config_reads), reads);
+
+	start = ktime_get();
+	for (i = 0; i < SAMSUNG_TEST_LOOPS; i++) {
+		invalidate_hw(bl);
+		read_brightness(bl);
+	}
+	uncached = ktime_to_ns(ktime_sub(ktime_get(), start));
+	KUNIT_EXPECT_EQ(test, stat_read(bl, config_reads),
+			reads + SAMSUNG_TEST_LOOPS);
+
+	start = ktime_get();
+	for (i = 0; i < SAMSUNG_TEST_LOOPS; i++)
+		set_brightness(bl, i % levels);
+	written = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	kunit_info(test, "read %llu ns cached, %llu ns uncached, write %llu ns\n",
+		   div_u64(cached, SAMSUNG_TEST_LOOPS),
+		   div_u64(uncached, SAMSUNG_TEST_LOOPS),
+		   div_u64(written, SAMSUNG_TEST_LOOPS));
+}
+
+static struct kunit_case samsung_test_cases[] = {
+	KUNIT_CASE(samsung_test_update_status),
+	KUNIT_CASE(samsung_test_set_brightness),
+	KUNIT_CASE(samsung_test_get_brightness),
+	KUNIT_CASE(samsung_test_shadow),
+	KUNIT_CASE(samsung_test_cost),
+	{ }
+};
+
+static struct kunit_suite samsung_test_suite = {
+	.name		= "samsung-backlight",
+	.init		= samsung_test_init,
+	.exit		= samsung_test_exit,
+	.test_cases	= samsung_test_cases,
+};
+kunit_test_suite(samsung_test_suite);
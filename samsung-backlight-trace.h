@@ -0,0 +1,121 @@
+/*
+ * Tracepoints for the Samsung Laptop Backlight driver
+ *
+ * Copyright (C) 2009 Greg Kroah-Hartman (gregkh@suse.de)
+ * Copyright (C) 2009 Novell Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM samsung_backlight
+
+#if !defined(_SAMSUNG_BACKLIGHT_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SAMSUNG_BACKLIGHT_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * A config space access of the brightness register.  'level' is the userspace
+ * brightness level that the hardware value maps to, 'duration' is how long
+ * the access itself took, in nanoseconds.
+ */
+DECLARE_EVENT_CLASS(samsung_bl_reg,
+
+	TP_PROTO(u8 level, u8 hw, int offset, u64 duration),
+
+	TP_ARGS(level, hw, offset, duration),
+
+	TP_STRUCT__entry(
+		__field(u8,	level)
+		__field(u8,	hw)
+		__field(int,	offset)
+		__field(u64,	duration)
+	),
+
+	TP_fast_assign(
+		__entry->level		= level;
+		__entry->hw		= hw;
+		__entry->offset		= offset;
+		__entry->duration	= duration;
+	),
+
+	TP_printk("level=%u hw=0x%02x offset=0x%02x duration=%lluns",
+		  __entry->level, __entry->hw, __entry->offset,
+		  (unsigned long long)__entry->duration)
+);
+
+DEFINE_EVENT(samsung_bl_reg, samsung_bl_reg_read,
+	TP_PROTO(u8 level, u8 hw, int offset, u64 duration),
+	TP_ARGS(level, hw, offset, duration)
+);
+
+DEFINE_EVENT(samsung_bl_reg, samsung_bl_reg_write,
+	TP_PROTO(u8 level, u8 hw, int offset, u64 duration),
+	TP_ARGS(level, hw, offset, duration)
+);
+
+/* a write that was dropped because the hardware already had that value */
+TRACE_EVENT(samsung_bl_write_skipped,
+
+	TP_PROTO(u8 level, u8 hw, int offset),
+
+	TP_ARGS(level, hw, offset),
+
+	TP_STRUCT__entry(
+		__field(u8,	level)
+		__field(u8,	hw)
+		__field(int,	offset)
+	),
+
+	TP_fast_assign(
+		__entry->level		= level;
+		__entry->hw		= hw;
+		__entry->offset		= offset;
+	),
+
+	TP_printk("level=%u hw=0x%02x offset=0x%02x",
+		  __entry->level, __entry->hw, __entry->offset)
+);
+
+/*
+ * Translation between a userspace level and a hardware value, 'write' tells
+ * which direction it went in.  This is the request, what actually reaches
+ * the hardware shows up in the register events above.
+ */
+TRACE_EVENT(samsung_bl_map,
+
+	TP_PROTO(u8 level, u8 hw, int offset, bool write),
+
+	TP_ARGS(level, hw, offset, write),
+
+	TP_STRUCT__entry(
+		__field(u8,	level)
+		__field(u8,	hw)
+		__field(int,	offset)
+		__field(bool,	write)
+	),
+
+	TP_fast_assign(
+		__entry->level		= level;
+		__entry->hw		= hw;
+		__entry->offset		= offset;
+		__entry->write		= write;
+	),
+
+	TP_printk("%s level=%u hw=0x%02x offset=0x%02x",
+		  __entry->write ? "set" : "get",
+		  __entry->level, __entry->hw, __entry->offset)
+);
+
+#endif /* _SAMSUNG_BACKLIGHT_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE samsung-backlight-trace
+#include <trace/define_trace.h>
@@ -10,164 +10,2524 @@
  *
  */
 
+#include <linux/version.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/pci.h>
+#include <linux/platform_device.h>
+#include <linux/pm.h>
 #include <linux/backlight.h>
 #include <linux/fb.h>
 #include <linux/dmi.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/firmware.h>
+#include <linux/delay.h>
+#include <linux/moduleparam.h>
+#include <linux/iio/consumer.h>
+#include <linux/input.h>
+#include <linux/power_supply.h>
+#include <linux/notifier.h>
 
 #define MAX_BRIGHT	0x07
+#define MAX_LEVELS	256
 #define OFFSET		0xf4
 
+/* the lowest value we ever write, and so the most levels we can offer */
+#define MIN_HW		1U
+#define MAX_USER_LEVELS	(MAX_LEVELS - MIN_HW)
+
+/* keep away from the standard PCI config header */
+#define MIN_OFFSET	0x40
+#define MAX_OFFSET	0xff
+
+/*
+ * HAL/gnome-display-manager really wants us to only set 8 different levels for
+ * the brightness control.  And since 256 different levels seems a bit
+ * overkill, that's fine.  So let's map the 256 values to 8 different ones:
+ *
+ * userspace	 0    1    2    3    4    5    6    7
+ * hardware	31   63   95  127  159  191  223  255
+ *
+ * or hardware = ((userspace + 1) * 32)-1
+ *
+ * Note, we keep value 0 at a positive value, otherwise the screen goes
+ * blank because HAL likes to set the backlight to 0 at startup when there is
+ * no power plugged in.
+ *
+ * Newer userspace copes just fine with more levels, so the number of levels
+ * can be picked with the 'levels' module parameter, all the way up to the
+ * 255 steps of the hardware that do not turn the screen off.  The general
+ * form of the mapping is
+ *
+ *	hardware = ((userspace + 1) * 256 / levels) - 1
+ *
+ * which is the table above for 8 levels, with level 0 held at 1 or more for
+ * the same reason as above.
+ *
+ * Our eyes do not see light linearly though, so the bottom levels all look
+ * alike and the top ones are all blinding.  The 'curve' module parameter can
+ * run the value above through a perceptual transfer curve (gamma 2.2 or CIE
+ * 1931 lightness) before it goes to the hardware.  The curves are precomputed
+ * tables that hang off of the model description, so a panel that needs its
+ * own curve can get one.
+ *
+ * Both directions are worked out once, when the driver loads, so setting or
+ * reading the brightness is just a table lookup.  Every level gets a
+ * hardware value of its own, and reading maps a hardware value to the nearest
+ * level, so whatever is written reads back exactly.
+ */
+
+enum samsung_curve {
+	CURVE_LINEAR,
+	CURVE_GAMMA22,
+	CURVE_CIE1931,
+	CURVE_MAX,
+};
+
+static const char * const curve_names[CURVE_MAX] = {
+	[CURVE_LINEAR]	= "linear",
+	[CURVE_GAMMA22]	= "gamma",
+	[CURVE_CIE1931]	= "cie",
+};
+
+/* hardware = 255 * (x / 255)^2.2 */
+static const u8 curve_gamma22[MAX_LEVELS] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+	  1,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,
+	  3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+	  6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,
+	 11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,
+	 16,  16,  17,  17,  18,  18,  19,  19,  20,  20,  21,  22,
+	 22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+	 30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,
+	 39,  39,  40,  41,  42,  43,  43,  44,  45,  46,  47,  48,
+	 49,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,
+	 60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+	 73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,
+	 87,  88,  89,  90,  91,  93,  94,  95,  97,  98,  99, 100,
+	102, 103, 105, 106, 107, 109, 110, 111, 113, 114, 116, 117,
+	119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+	137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154,
+	156, 158, 159, 161, 163, 165, 166, 168, 170, 172, 173, 175,
+	177, 179, 181, 182, 184, 186, 188, 190, 192, 194, 196, 197,
+	199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+	223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246,
+	248, 251, 253, 255,
+};
+
+/* CIE 1931 lightness, x is L* scaled to 0-255 */
+static const u8 curve_cie1931[MAX_LEVELS] = {
+	  0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,
+	  1,   1,   2,   2,   2,   2,   2,   2,   2,   2,   2,   3,
+	  3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,
+	  4,   5,   5,   5,   5,   5,   6,   6,   6,   6,   6,   7,
+	  7,   7,   7,   8,   8,   8,   8,   9,   9,   9,  10,  10,
+	 10,  10,  11,  11,  11,  12,  12,  12,  13,  13,  13,  14,
+	 14,  15,  15,  15,  16,  16,  17,  17,  17,  18,  18,  19,
+	 19,  20,  20,  21,  21,  22,  22,  23,  23,  24,  24,  25,
+	 25,  26,  26,  27,  28,  28,  29,  29,  30,  31,  31,  32,
+	 32,  33,  34,  34,  35,  36,  37,  37,  38,  39,  39,  40,
+	 41,  42,  43,  43,  44,  45,  46,  47,  47,  48,  49,  50,
+	 51,  52,  53,  54,  54,  55,  56,  57,  58,  59,  60,  61,
+	 62,  63,  64,  65,  66,  67,  68,  70,  71,  72,  73,  74,
+	 75,  76,  77,  79,  80,  81,  82,  83,  85,  86,  87,  88,
+	 90,  91,  92,  94,  95,  96,  98,  99, 100, 102, 103, 105,
+	106, 108, 109, 110, 112, 113, 115, 116, 118, 120, 121, 123,
+	124, 126, 128, 129, 131, 132, 134, 136, 138, 139, 141, 143,
+	145, 146, 148, 150, 152, 154, 155, 157, 159, 161, 163, 165,
+	167, 169, 171, 173, 175, 177, 179, 181, 183, 185, 187, 189,
+	191, 193, 196, 198, 200, 202, 204, 207, 209, 211, 214, 216,
+	218, 220, 223, 225, 228, 230, 232, 235, 237, 240, 242, 245,
+	247, 250, 252, 255,
+};
+
+struct samsung_reg_ops;
+
+struct samsung_model {
+	/* how to get at the register, NULL means PCI config space */
+	const struct samsung_reg_ops *reg_ops;
+	int offset;
+	unsigned int levels;
+	enum samsung_curve curve;
+	/* NULL means linear */
+	const u8 *curves[CURVE_MAX];
+	/* PCI device to look for, 0 for the samsung_pci_ids list */
+	u16 pci_vendor;
+	u16 pci_device;
+};
+
+/* what all of the currently known models want, see above */
+static const struct samsung_model samsung_legacy = {
+	.offset = OFFSET,
+	.levels = MAX_BRIGHT + 1,
+	.curve = CURVE_LINEAR,
+	.curves = {
+		[CURVE_GAMMA22]	= curve_gamma22,
+		[CURVE_CIE1931]	= curve_cie1931,
+	},
+};
+
+static unsigned int levels;
+module_param(levels, uint, S_IRUGO);
+MODULE_PARM_DESC(levels, "Number of brightness levels, 2-255 (0 = model default)");
+
+static char *curve;
+module_param(curve, charp, S_IRUGO);
+MODULE_PARM_DESC(curve, "Brightness transfer curve: linear, gamma or cie (default: model default)");
+
+static const struct samsung_model *model;
+static u8 level_to_hw[MAX_LEVELS];
+static u8 hw_to_level[MAX_LEVELS];
+
+static int find_curve(const char *name)
+{
+	int i;
+
+	for (i = 0; i < CURVE_MAX; i++)
+		if (!strcmp(name, curve_names[i]))
+			return i;
+	return -EINVAL;
+}
+
+static void build_level_tables(unsigned int count, const u8 *table)
+{
+	unsigned int level;
+	unsigned int hw;
+
+	for (level = 0; level < count; level++) {
+		hw = ((level + 1) * MAX_LEVELS / count) - 1;
+		if (table)
+			hw = table[hw];
+		/* the curves start out at 0 too, which blanks the screen */
+		hw = max(hw, MIN_HW);
+		/* a curve is flat at the bottom, spread the levels out */
+		if (level && hw <= level_to_hw[level - 1])
+			hw = level_to_hw[level - 1] + 1;
+		level_to_hw[level] = min(hw, MAX_LEVELS - 1U);
+	}
+
+	/* and make room again at the top if that ran us into the ceiling */
+	for (level = count - 1; level > 0; level--)
+		if (level_to_hw[level - 1] >= level_to_hw[level])
+			level_to_hw[level - 1] = level_to_hw[level] - 1;
+
+	/* a hardware value maps to the nearest level, ties round up */
+	level = 0;
+	for (hw = 0; hw < MAX_LEVELS; hw++) {
+		while (level + 1 < count &&
+		       hw >= (level_to_hw[level] + level_to_hw[level + 1] + 1) / 2)
+			level++;
+		hw_to_level[hw] = level;
+	}
+}
+
+static u8 hw_to_user(u8 kernel_brightness)
+{
+	return hw_to_level[kernel_brightness];
+}
+
+static u8 user_to_hw(u8 user_brightness)
+{
+	return level_to_hw[user_brightness];
+}
+
+#define CREATE_TRACE_POINTS
+#include "samsung-backlight-trace.h"
+
+static int offset = -1;
+
+/*
+ * Statistics, exported through debugfs.  The counters are per-cpu so that
+ * keeping them costs next to nothing on the brightness paths, they are only
+ * added up when someone reads them.  The latency of config space writes, and
+ * of update_status() which is what a write to the brightness file ends up
+ * in, is kept as a log2 histogram: bucket n counts the calls that took less
+ * than 2^n ns (and at least 2^(n-1) ns).  The total time is kept as well, so
+ * the mean is exact.
+ */
+#define LATENCY_BUCKETS	32
+#define latency_bucket(ns)	min(fls64(ns), LATENCY_BUCKETS - 1)
+
+struct samsung_stats {
+	unsigned long	config_reads;
+	unsigned long	config_writes;
+	unsigned long	writes_skipped;
+	unsigned long	writes_absorbed;
+	unsigned long	writes_issued;
+	unsigned long	updates;
+	unsigned long	write_latency[LATENCY_BUCKETS];
+	unsigned long	update_latency[LATENCY_BUCKETS];
+	u64		write_time;
+	u64		update_time;
+	u64		time_at_level[MAX_LEVELS];
+};
+
+/* one step of an animation, as written to the 'animation' file */
+struct samsung_keyframe {
+	__le32	time;		/* in ms, from the start of the animation */
+	__le16	level;
+	__le16	reserved;	/* must be 0 */
+} __packed;
+
+#define MAX_KEYFRAMES	256
+#define KEYFRAME_STOP	0xffff	/* level of a lone keyframe that stops it */
+
+/*
+ * One of these for every backlight we drive.  Everything in here belongs to
+ * that one panel, so several of them can be driven independently of each
+ * other.
+ */
+struct samsung_bl {
+	struct list_head	list;
+	struct pci_dev		*pci_device;
+	struct backlight_device	*bd;
+	const struct samsung_reg_ops *reg_ops;
+	int			offset;		/* protected by hw_lock */
+
+	/* shadow copy of the hardware register, see read_hw() */
+	spinlock_t		hw_lock;
+	unsigned int		hw_cache;	/* value | HW_CACHE_VALID */
+	ktime_t			hw_since;	/* when hw_cache got its value */
+
+	/* highest level while dimmed for idle, -1 if not, see idle_check() */
+	int			idle_cap;
+
+	/* brightness ramping, see start_ramp() */
+	int			ramp_ms;	/* -1 is the module default */
+	struct hrtimer		ramp_timer;
+	u8			ramp_target;
+	u8			ramp_stride;
+	ktime_t			ramp_period;
+
+	/* write coalescing, see set_brightness() */
+	spinlock_t		coalesce_lock;
+	struct delayed_work	coalesce_work;
+	unsigned long		coalesce_last;
+	bool			coalesce_pending;
+	u8			coalesce_level;
+
+	/* statistics */
+	struct samsung_stats __percpu *stats;
+	spinlock_t		last_writer_lock;
+	pid_t			last_writer_pid;
+	char			last_writer_comm[TASK_COMM_LEN];
+	struct dentry		*debugfs_dir;
+
+	/* level to restore after a suspend */
+	u8			saved_hw;
+	/* orders our suspend and resume against the PCI device's */
+	struct device_link	*link;
+
+	/* register file standing in for config space, see loopback */
+	u8			*loopback_regs;
+
+	/* keyframe animation, see animation_write() */
+	struct mutex		anim_lock;
+	struct hrtimer		anim_timer;
+	struct samsung_keyframe	*anim_frames;
+	unsigned int		anim_count;
+	unsigned int		anim_index;
+	ktime_t			anim_start;
+	struct work_struct	anim_work;
+	int			anim_level;	/* to report, -1 for none */
+};
+
+/* all of the backlights we drive, protected by samsung_lock */
+static LIST_HEAD(samsung_devices);
+static DEFINE_MUTEX(samsung_lock);
+
+#define stat_inc(bl, field)		this_cpu_inc((bl)->stats->field)
+#define stat_add(bl, field, val)	this_cpu_add((bl)->stats->field, val)
+
+#define stat_read(bl, field)					\
+({								\
+	typeof((bl)->stats->field) __sum = 0;			\
+	int __cpu;						\
+	for_each_possible_cpu(__cpu)				\
+		__sum += per_cpu_ptr((bl)->stats, __cpu)->field;	\
+	__sum;							\
+})
+
+/* who asked for the current brightness */
+static void record_writer(struct samsung_bl *bl)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bl->last_writer_lock, flags);
+	bl->last_writer_pid = task_pid_nr(current);
+	get_task_comm(bl->last_writer_comm, current);
+	spin_unlock_irqrestore(&bl->last_writer_lock, flags);
+}
+
+/*
+ * Register access backends.  Every model says how its brightness register is
+ * reached, which so far has always been a byte in PCI config space, and RAM
+ * for the loopback backlights.  Anything else, like the SABI calls or EC
+ * registers of later models, plugs in here as another samsung_reg_ops.
+ *
+ * The backends besides PCI can be left out at build time, see the Makefile.
+ * Every backend that is built goes into samsung_reg_backends[], with only PCI
+ * in there config_read() and config_write() call it directly, and even with
+ * more of them the PCI case is tested for first so the common case never
+ * goes through a function pointer.
+ *
+ * setup() is called before anything else touches the register, and can
+ * refuse the device, release() when the backlight goes away.  Both are
+ * optional.  Finding the devices is still up to samsung_probe(), which only
+ * knows about PCI devices and the loopback ones.
+ */
+struct samsung_reg_ops {
+	const char *name;
+	int (*setup)(struct samsung_bl *bl);
+	void (*release)(struct samsung_bl *bl);
+	void (*read)(struct samsung_bl *bl, u8 *value);
+	void (*write)(struct samsung_bl *bl, u8 value);
+};
+
+static void pci_reg_read(struct samsung_bl *bl, u8 *value)
+{
+	pci_read_config_byte(bl->pci_device, bl->offset, value);
+}
+
+static void pci_reg_write(struct samsung_bl *bl, u8 value)
+{
+	pci_write_config_byte(bl->pci_device, bl->offset, value);
+}
+
+static const struct samsung_reg_ops pci_reg_ops = {
+	.name	= "pci",
+	.read	= pci_reg_read,
+	.write	= pci_reg_write,
+};
+
+#define LOOPBACK_REGS	256
+
+#ifdef CONFIG_SAMSUNG_BACKLIGHT_LOOPBACK
+/*
+ * Loopback mode.  For testing and benchmarking on machines without one of
+ * these laptops, 'loopback=N' creates N fake backlights whose "config space"
+ * is just a chunk of RAM, no DMI or PCI match needed.  'loopback_delay_ns'
+ * makes every access to it take that much longer, to look a bit more like
+ * the real thing.
+ */
+static unsigned int loopback;
+module_param(loopback, uint, S_IRUGO);
+MODULE_PARM_DESC(loopback, "Number of RAM backed fake backlights to create instead of real ones");
+
+/*
+ * The delay is spent under hw_lock with interrupts off, so keep it to what a
+ * slow bus could plausibly take.
+ */
+#define LOOPBACK_MAX_DELAY_NS	100000U
+
+static unsigned int loopback_delay_ns;
+
+static int loopback_delay_set(const char *val, const struct kernel_param *kp)
+{
+	unsigned int delay;
+	int retval;
+
+	retval = kstrtouint(val, 0, &delay);
+	if (retval)
+		return retval;
+
+	WRITE_ONCE(loopback_delay_ns, min(delay, LOOPBACK_MAX_DELAY_NS));
+	return 0;
+}
+
+static const struct kernel_param_ops loopback_delay_ops = {
+	.set	= loopback_delay_set,
+	.get	= param_get_uint,
+};
+module_param_cb(loopback_delay_ns, &loopback_delay_ops, &loopback_delay_ns,
+		S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(loopback_delay_ns, "Extra latency in nanoseconds for every loopback register access (at most 100000)");
+
+static int loopback_reg_setup(struct samsung_bl *bl)
+{
+	bl->loopback_regs = kzalloc(LOOPBACK_REGS, GFP_KERNEL);
+	if (!bl->loopback_regs)
+		return -ENOMEM;
+	/* come up at full brightness, like the BIOS leaves it */
+	bl->loopback_regs[bl->offset] = 0xff;
+	return 0;
+}
+
+static void loopback_reg_release(struct samsung_bl *bl)
+{
+	kfree(bl->loopback_regs);
+}
+
+static void loopback_reg_read(struct samsung_bl *bl, u8 *value)
+{
+	unsigned int delay = READ_ONCE(loopback_delay_ns);
+
+	if (delay)
+		ndelay(delay);
+	*value = bl->loopback_regs[bl->offset];
+}
+
+static void loopback_reg_write(struct samsung_bl *bl, u8 value)
+{
+	unsigned int delay = READ_ONCE(loopback_delay_ns);
+
+	if (delay)
+		ndelay(delay);
+	bl->loopback_regs[bl->offset] = value;
+}
+
+static const struct samsung_reg_ops loopback_reg_ops = {
+	.name	= "loopback",
+	.setup	= loopback_reg_setup,
+	.release = loopback_reg_release,
+	.read	= loopback_reg_read,
+	.write	= loopback_reg_write,
+};
+#else
+#define loopback	0
+#endif
+
+static const struct samsung_reg_ops *const samsung_reg_backends[] = {
+	&pci_reg_ops,
+#ifdef CONFIG_SAMSUNG_BACKLIGHT_LOOPBACK
+	&loopback_reg_ops,
+#endif
+};
+
+/* a compile time constant, so with only PCI built the tests go away */
+#define SAMSUNG_REG_OPS_MULTI	(ARRAY_SIZE(samsung_reg_backends) > 1)
+
+/*
+ * pci_device is NULL for the loopback backlights.  A model that wants a
+ * backend which is not built in gets nothing, rather than quietly ending up
+ * with PCI.
+ */
+static const struct samsung_reg_ops *find_reg_ops(struct pci_dev *pci_device)
+{
+	const struct samsung_reg_ops *ops = model->reg_ops ?: &pci_reg_ops;
+	int i;
+
+#ifdef CONFIG_SAMSUNG_BACKLIGHT_LOOPBACK
+	if (!pci_device)
+		return &loopback_reg_ops;
+#endif
+	for (i = 0; i < ARRAY_SIZE(samsung_reg_backends); i++)
+		if (samsung_reg_backends[i] == ops)
+			return ops;
+	return NULL;
+}
+
+static inline void config_read(struct samsung_bl *bl, u8 *value)
+{
+	if (SAMSUNG_REG_OPS_MULTI && unlikely(bl->reg_ops != &pci_reg_ops)) {
+		bl->reg_ops->read(bl, value);
+		return;
+	}
+	pci_reg_read(bl, value);
+}
+
+static inline void config_write(struct samsung_bl *bl, u8 value)
+{
+	if (SAMSUNG_REG_OPS_MULTI && unlikely(bl->reg_ops != &pci_reg_ops)) {
+		bl->reg_ops->write(bl, value);
+		return;
+	}
+	pci_reg_write(bl, value);
+}
+
+/*
+ * Shadow copy of the hardware register at 'offset'.  Desktop daemons love to
+ * write the same brightness over and over again, and every config space access
+ * goes through the global PCI config lock, so we only touch the hardware when
+ * the value really changes, and serve reads out of the shadow.  The shadow is
+ * thrown away (and re-read) when userspace writes to the 'resync' attribute.
+ *
+ * The value and whether it is valid at all live together in one word, which
+ * is only ever changed with hw_lock held, but can be looked at without it.
+ * That way status bars and other things polling the brightness never have to
+ * wait for a writer.
+ */
+#define HW_CACHE_VALID		0x100
+#define hw_cache_valid(cache)	((cache) & HW_CACHE_VALID)
+#define hw_cache_value(cache)	((u8)(cache))
+
+static void set_hw_cache(struct samsung_bl *bl, u8 value)
+{
+	WRITE_ONCE(bl->hw_cache, value | HW_CACHE_VALID);
+}
+
+/* must be called with hw_lock held */
+static u8 __read_hw(struct samsung_bl *bl)
+{
+	unsigned int cache = bl->hw_cache;
+	bool traced;
+	ktime_t start = ktime_set(0, 0);
+	u8 value;
+
+	if (hw_cache_valid(cache))
+		return hw_cache_value(cache);
+
+	/* only pay for the timestamps if someone is listening */
+	traced = trace_samsung_bl_reg_read_enabled();
+	if (traced)
+		start = ktime_get();
+	config_read(bl, &value);
+	set_hw_cache(bl, value);
+	stat_inc(bl, config_reads);
+	if (!bl->hw_since)
+		bl->hw_since = ktime_get();
+	if (traced)
+		trace_samsung_bl_reg_read(hw_to_user(value), value, bl->offset,
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+	return value;
+}
+
+/* must be called with hw_lock held */
+static void __write_hw(struct samsung_bl *bl, u8 value)
+{
+	unsigned int cache = bl->hw_cache;
+	ktime_t start, end;
+	u64 duration;
+
+	if (hw_cache_valid(cache) && hw_cache_value(cache) == value) {
+		stat_inc(bl, writes_skipped);
+		trace_samsung_bl_write_skipped(hw_to_user(value), value,
+					       bl->offset);
+		return;
+	}
+
+	start = ktime_get();
+	config_write(bl, value);
+	end = ktime_get();
+	duration = ktime_to_ns(ktime_sub(end, start));
+
+	stat_inc(bl, config_writes);
+	stat_inc(bl, write_latency[latency_bucket(duration)]);
+	stat_add(bl, write_time, duration);
+	if (hw_cache_valid(cache) && bl->hw_since)
+		stat_add(bl, time_at_level[hw_to_user(hw_cache_value(cache))],
+			 ktime_to_ns(ktime_sub(end, bl->hw_since)));
+	bl->hw_since = end;
+
+	set_hw_cache(bl, value);
+	trace_samsung_bl_reg_write(hw_to_user(value), value, bl->offset,
+				   duration);
+}
+
+static u8 read_hw(struct samsung_bl *bl)
+{
+	unsigned int cache = READ_ONCE(bl->hw_cache);
+	unsigned long flags;
+	u8 value;
+
+	/* the common case, no lock needed */
+	if (hw_cache_valid(cache))
+		return hw_cache_value(cache);
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	value = __read_hw(bl);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	return value;
+}
+
+static void write_hw(struct samsung_bl *bl, u8 value)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	__write_hw(bl, value);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+}
+
+static void invalidate_hw(struct samsung_bl *bl)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	WRITE_ONCE(bl->hw_cache, 0);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+}
+
+/*
+ * Drop the shadow and read the hardware again in one go, so none of our own
+ * writes can get in between.  Returns true if the register no longer holds
+ * what we last wrote to it or read from it.
+ */
+static bool reread_hw(struct samsung_bl *bl, u8 *value)
+{
+	unsigned long flags;
+	unsigned int cache;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	cache = bl->hw_cache;
+	WRITE_ONCE(bl->hw_cache, 0);
+	*value = __read_hw(bl);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	return !hw_cache_valid(cache) || hw_cache_value(cache) != *value;
+}
+
+/*
+ * Brightness ramping.  If 'ramp_ms' is set, a new brightness level is not
+ * written to the hardware in one go, but the register is stepped towards it
+ * from a hrtimer, so that the whole fade takes roughly 'ramp_ms' milliseconds.
+ * A new level showing up in the middle of a ramp just changes the target, the
+ * ramp carries on from wherever the hardware is at that moment.
+ *
+ * Each backlight also has a 'ramp_ms' file of its own, so userspace can pick
+ * the fade for the next level it writes.  -1 there, the default, means use
+ * the module parameter.
+ */
+#define RAMP_MIN_PERIOD_NS	(1 * NSEC_PER_MSEC)
+
+static unsigned int ramp_ms;
+module_param(ramp_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ramp_ms, "Time in milliseconds to fade to a new brightness level (0 = change it at once)");
+
+/* hrtimer_setup() took over from hrtimer_init() in 6.13, which went in 6.15 */
+static void samsung_hrtimer_setup(struct hrtimer *timer,
+		enum hrtimer_restart (*function)(struct hrtimer *),
+		enum hrtimer_mode mode)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(timer, function, CLOCK_MONOTONIC, mode);
+#else
+	hrtimer_init(timer, CLOCK_MONOTONIC, mode);
+	timer->function = function;
+#endif
+}
+
+static enum hrtimer_restart ramp_step(struct hrtimer *timer)
+{
+	struct samsung_bl *bl = container_of(timer, struct samsung_bl,
+					     ramp_timer);
+	unsigned long flags;
+	bool done;
+	u8 value;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	value = __read_hw(bl);
+	if (value < bl->ramp_target)
+		value = min_t(unsigned int, value + bl->ramp_stride,
+			      bl->ramp_target);
+	else if (value > bl->ramp_target)
+		value = max_t(int, value - bl->ramp_stride, bl->ramp_target);
+	__write_hw(bl, value);
+	done = (value == bl->ramp_target);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	if (done)
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(timer, bl->ramp_period);
+	return HRTIMER_RESTART;
+}
+
+static void start_ramp(struct samsung_bl *bl, u8 target,
+		       unsigned int duration_ms)
+{
+	unsigned long flags;
+	unsigned int delta;
+	u64 period;
+	u8 value;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	value = __read_hw(bl);
+	delta = abs((int)target - (int)value);
+	bl->ramp_target = target;
+	if (!delta) {
+		spin_unlock_irqrestore(&bl->hw_lock, flags);
+		return;
+	}
+
+	/*
+	 * Step one hardware unit at a time if we can, but don't fire the
+	 * timer more often than every RAMP_MIN_PERIOD_NS, take bigger
+	 * steps instead.
+	 */
+	period = div_u64((u64)duration_ms * NSEC_PER_MSEC, delta);
+	bl->ramp_stride = 1;
+	if (period < RAMP_MIN_PERIOD_NS) {
+		bl->ramp_stride = min_t(u64,
+					DIV_ROUND_UP(RAMP_MIN_PERIOD_NS,
+						     max_t(u64, period, 1)),
+					delta);
+		period *= bl->ramp_stride;
+	}
+	bl->ramp_period = ns_to_ktime(period);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	hrtimer_start(&bl->ramp_timer, bl->ramp_period, HRTIMER_MODE_REL_SOFT);
+}
+
+static u8 read_brightness(struct samsung_bl *bl)
+{
+	u8 kernel_brightness;
+	u8 user_brightness = 0;
+
+	kernel_brightness = read_hw(bl);
+	user_brightness = hw_to_user(kernel_brightness);
+	trace_samsung_bl_map(user_brightness, kernel_brightness, bl->offset,
+			     false);
+	return user_brightness;
+}
+
+/*
+ * Tell userspace the brightness changed behind its back, like the backlight
+ * core's own backlight_force_update() does for a hotkey.  That one would also
+ * pull props.brightness back in through get_brightness(), which reports the
+ * hardware, and so could hand it a level we are still fading through, or
+ * one that is held down while idle.  Call without ops_lock held.
+ */
+static void notify_brightness(struct backlight_device *bd)
+{
+	char *envp[] = { "SOURCE=hotkey", NULL };
+
+	kobject_uevent_env(&bd->dev.kobj, KOBJ_CHANGE, envp);
+	sysfs_notify(&bd->dev.kobj, NULL, "actual_brightness");
+}
+
+/* while idle, levels are held down, the one asked for is restored later */
+static u8 idle_cap_level(struct samsung_bl *bl, u8 user_brightness)
+{
+	int cap = READ_ONCE(bl->idle_cap);
+
+	if (cap >= 0 && user_brightness > cap)
+		return cap;
+	return user_brightness;
+}
+
+/* push a level out to the hardware, fading over duration ms if not 0 */
+static void __apply_brightness(struct samsung_bl *bl, u8 user_brightness,
+			       unsigned int duration)
+{
+	u16 kernel_brightness = 0;
+
+	user_brightness = idle_cap_level(bl, user_brightness);
+	kernel_brightness = user_to_hw(user_brightness);
+	trace_samsung_bl_map(user_brightness, kernel_brightness, bl->offset,
+			     true);
+	if (duration) {
+		start_ramp(bl, (u8)kernel_brightness, duration);
+		return;
+	}
+
+	/* a plain write wins over any fade that is still running */
+	hrtimer_cancel(&bl->ramp_timer);
+	write_hw(bl, (u8)kernel_brightness);
+}
+
+/* the fade time for this backlight */
+static unsigned int ramp_duration(struct samsung_bl *bl)
+{
+	int duration = READ_ONCE(bl->ramp_ms);
+
+	return duration < 0 ? ramp_ms : duration;
+}
+
+static void apply_brightness(struct samsung_bl *bl, u8 user_brightness)
+{
+	__apply_brightness(bl, user_brightness, ramp_duration(bl));
+}
+
+/*
+ * Keyframe animations.  Instead of poking the brightness file at the right
+ * moments, userspace can write a whole list of keyframes to the binary
+ * 'animation' file in one go, and we play it back from a timer.  At the time
+ * of each keyframe the hardware reaches that keyframe's level, and in between
+ * we ramp linearly from one to the next.  Keyframe times are in milliseconds
+ * from the moment of the write and may not go backwards.  Writing a new
+ * animation replaces the running one.  Writing a single keyframe with level
+ * KEYFRAME_STOP, or setting the brightness, stops it.  The reserved field of
+ * every keyframe has to be 0.
+ *
+ * Each keyframe level is also handed to the backlight core and reported to
+ * userspace.  The timer can not take the core's lock, so that is done from a
+ * work item.
+ */
+static enum hrtimer_restart anim_step(struct hrtimer *timer)
+{
+	struct samsung_bl *bl = container_of(timer, struct samsung_bl,
+					     anim_timer);
+	const struct samsung_keyframe *frame = &bl->anim_frames[bl->anim_index];
+	u32 time = le32_to_cpu(frame->time);
+	u32 prev = 0;
+	u8 level = le16_to_cpu(frame->level);
+
+	if (bl->anim_index)
+		prev = le32_to_cpu(bl->anim_frames[bl->anim_index - 1].time);
+
+	/* head for this keyframe, arriving at its time */
+	WRITE_ONCE(bl->anim_level, level);
+	schedule_work(&bl->anim_work);
+	start_ramp(bl, user_to_hw(idle_cap_level(bl, level)), time - prev);
+
+	if (++bl->anim_index == bl->anim_count)
+		return HRTIMER_NORESTART;
+
+	hrtimer_set_expires(timer, ktime_add_ms(bl->anim_start, time));
+	return HRTIMER_RESTART;
+}
+
+static void anim_report(struct work_struct *work)
+{
+	struct samsung_bl *bl = container_of(work, struct samsung_bl,
+					     anim_work);
+	struct backlight_device *bd = bl->bd;
+	int level;
+
+	mutex_lock(&bd->ops_lock);
+	/* a brightness store that stopped the animation has the last word */
+	level = READ_ONCE(bl->anim_level);
+	if (level >= 0)
+		bd->props.brightness = level;
+	mutex_unlock(&bd->ops_lock);
+
+	/* the brightness file did not change, so not a sysfs update */
+	if (level >= 0)
+		notify_brightness(bd);
+}
+
+static void stop_animation(struct samsung_bl *bl)
+{
+	hrtimer_cancel(&bl->anim_timer);
+	WRITE_ONCE(bl->anim_level, -1);
+}
+
+/* sysfs hands out bin_attributes as const since 6.16 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 16, 0)
+#define __bin_attr_const	const
+#else
+#define __bin_attr_const
+#endif
+
+static ssize_t animation_write(struct file *filp, struct kobject *kobj,
+			       __bin_attr_const struct bin_attribute *attr,
+			       char *buf,
+			       loff_t off, size_t count)
+{
+	struct backlight_device *bd = to_backlight_device(kobj_to_dev(kobj));
+	struct samsung_bl *bl = bl_get_data(bd);
+	const struct samsung_keyframe *frames = (void *)buf;
+	struct samsung_keyframe *copy = NULL;
+	unsigned int n = count / sizeof(*frames);
+	unsigned int i;
+	u32 time = 0;
+
+	/* the whole animation has to come in one write */
+	if (off || count % sizeof(*frames) || n > MAX_KEYFRAMES)
+		return -EINVAL;
+
+	/* sysfs never hands us an empty write, so this is how to stop one */
+	if (n == 1 && le16_to_cpu(frames[0].level) == KEYFRAME_STOP &&
+	    !frames[0].reserved)
+		n = 0;
+
+	for (i = 0; i < n; i++) {
+		if (le16_to_cpu(frames[i].level) >= levels ||
+		    le32_to_cpu(frames[i].time) < time ||
+		    frames[i].reserved)
+			return -EINVAL;
+		time = le32_to_cpu(frames[i].time);
+	}
+
+	if (n) {
+		copy = kmemdup(frames, count, GFP_KERNEL);
+		if (!copy)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&bl->anim_lock);
+	stop_animation(bl);
+	kfree(bl->anim_frames);
+	bl->anim_frames = copy;
+	bl->anim_count = n;
+	bl->anim_index = 0;
+	if (n) {
+		bl->anim_start = ktime_get();
+		hrtimer_start(&bl->anim_timer, bl->anim_start,
+			      HRTIMER_MODE_ABS_SOFT);
+	}
+	mutex_unlock(&bl->anim_lock);
+
+	return count;
+}
+/*
+ * No size, or sysfs would quietly cut a write that is too big down to the
+ * first MAX_KEYFRAMES keyframes, instead of letting us refuse it.
+ */
+static BIN_ATTR(animation, S_IWUSR, NULL, animation_write, 0);
+
+/*
+ * Write coalescing.  Dragging a brightness slider around can easily produce
+ * hundreds of updates a second, almost all of which are overwritten again
+ * before anyone could see them.  If 'coalesce_ms' is set, a new level is only
+ * remembered, and a work item pushes the latest one out to the hardware, at
+ * most once every 'coalesce_ms' milliseconds.
+ */
+static unsigned int coalesce_ms;
+module_param(coalesce_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(coalesce_ms, "Minimum time in milliseconds between brightness writes to the hardware (0 = write every change)");
+
+static void coalesce_flush(struct work_struct *work)
+{
+	struct samsung_bl *bl = container_of(to_delayed_work(work),
+					     struct samsung_bl, coalesce_work);
+	unsigned long flags;
+	bool pending;
+	u8 level;
+
+	spin_lock_irqsave(&bl->coalesce_lock, flags);
+	pending = bl->coalesce_pending;
+	level = bl->coalesce_level;
+	bl->coalesce_pending = false;
+	bl->coalesce_last = jiffies;
+	if (pending)
+		stat_inc(bl, writes_issued);
+	spin_unlock_irqrestore(&bl->coalesce_lock, flags);
+
+	if (pending)
+		apply_brightness(bl, level);
+}
+
+/* forget a level that is still waiting to be flushed */
+static void drop_coalesced(struct samsung_bl *bl)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bl->coalesce_lock, flags);
+	bl->coalesce_pending = false;
+	spin_unlock_irqrestore(&bl->coalesce_lock, flags);
+}
+
+static void set_brightness(struct samsung_bl *bl, u8 user_brightness)
+{
+	unsigned int window = coalesce_ms;
+	unsigned long flags;
+	unsigned long next;
+	unsigned long delay = 0;
+
+	record_writer(bl);
+	stop_animation(bl);
+
+	if (!window) {
+		/* don't let an older queued level overwrite this one */
+		drop_coalesced(bl);
+		apply_brightness(bl, user_brightness);
+		return;
+	}
+
+	spin_lock_irqsave(&bl->coalesce_lock, flags);
+	if (bl->coalesce_pending)
+		stat_inc(bl, writes_absorbed);
+	bl->coalesce_level = user_brightness;
+	bl->coalesce_pending = true;
+	next = bl->coalesce_last + msecs_to_jiffies(window);
+	if (time_after(next, jiffies))
+		delay = next - jiffies;
+	spin_unlock_irqrestore(&bl->coalesce_lock, flags);
+
+	/* does nothing if a flush is already queued, it will pick us up */
+	schedule_delayed_work(&bl->coalesce_work, delay);
+}
+
+/*
+ * What actual_brightness reports, and what status bars poll, is what the
+ * hardware is at right now, in the middle of a fade too.  Out of the shadow
+ * register, so this takes no locks of ours unless the shadow was dropped.
+ */
+static int get_brightness(struct backlight_device *bd)
+{
+	return read_brightness(bl_get_data(bd));
+}
+
+static int update_status(struct backlight_device *bd)
+{
+	struct samsung_bl *bl = bl_get_data(bd);
+	ktime_t start = ktime_get();
+	u64 duration;
+
+	set_brightness(bl, bd->props.brightness);
+
+	duration = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stat_inc(bl, updates);
+	stat_inc(bl, update_latency[latency_bucket(duration)]);
+	stat_add(bl, update_time, duration);
+	return 0;
+}
+
+static struct backlight_ops backlight_ops = {
+	.get_brightness	= get_brightness,
+	.update_status	= update_status,
+};
+
+static struct samsung_bl *dev_to_bl(struct device *dev)
+{
+	return bl_get_data(to_backlight_device(dev));
+}
+
+/*
+ * Writing anything to the 'resync' file drops the shadow register, re-reads
+ * the hardware and updates the brightness the backlight core reports.  Use
+ * this if something else (the BIOS, a hotkey) changed the register behind
+ * our back, userspace hears about it like about a hotkey press.
+ */
+static ssize_t resync_store(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct samsung_bl *bl = dev_to_bl(dev);
+	struct backlight_device *bd = bl->bd;
+	unsigned int level;
+	bool moved;
+
+	mutex_lock(&bd->ops_lock);
+	invalidate_hw(bl);
+	level = read_brightness(bl);
+	moved = level != bd->props.brightness;
+	bd->props.brightness = level;
+	mutex_unlock(&bd->ops_lock);
+
+	if (moved)
+		notify_brightness(bd);
+	return count;
+}
+static DEVICE_ATTR(resync, S_IWUSR, NULL, resync_store);
+
+static ssize_t ramp_ms_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	return sprintf(buf, "%d\n", READ_ONCE(dev_to_bl(dev)->ramp_ms));
+}
+
+static ssize_t ramp_ms_store(struct device *dev, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	int value;
+	int retval;
+
+	retval = kstrtoint(buf, 0, &value);
+	if (retval)
+		return retval;
+	if (value < -1)
+		return -EINVAL;
+	WRITE_ONCE(dev_to_bl(dev)->ramp_ms, value);
+	return count;
+}
+static DEVICE_ATTR(ramp_ms, S_IRUGO | S_IWUSR, ramp_ms_show, ramp_ms_store);
+
+static ssize_t writes_absorbed_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", stat_read(dev_to_bl(dev), writes_absorbed));
+}
+static DEVICE_ATTR(writes_absorbed, S_IRUGO, writes_absorbed_show, NULL);
+
+static ssize_t writes_issued_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", stat_read(dev_to_bl(dev), writes_issued));
+}
+static DEVICE_ATTR(writes_issued, S_IRUGO, writes_issued_show, NULL);
+
+static struct attribute *samsung_attributes[] = {
+	&dev_attr_resync.attr,
+	&dev_attr_ramp_ms.attr,
+	&dev_attr_writes_absorbed.attr,
+	&dev_attr_writes_issued.attr,
+	NULL
+};
+
+static __bin_attr_const struct bin_attribute *__bin_attr_const
+samsung_bin_attributes[] = {
+	&bin_attr_animation,
+	NULL
+};
+
+static const struct attribute_group samsung_attr_group = {
+	.attrs = samsung_attributes,
+	.bin_attrs = samsung_bin_attributes,
+};
+
+static int stats_show(struct seq_file *m, void *unused)
+{
+	struct samsung_bl *bl = m->private;
+
+	seq_printf(m, "backend:         %s\n", bl->reg_ops->name);
+	seq_printf(m, "config_reads:    %lu\n", stat_read(bl, config_reads));
+	seq_printf(m, "config_writes:   %lu\n", stat_read(bl, config_writes));
+	seq_printf(m, "writes_skipped:  %lu\n", stat_read(bl, writes_skipped));
+	seq_printf(m, "writes_absorbed: %lu\n", stat_read(bl, writes_absorbed));
+	seq_printf(m, "writes_issued:   %lu\n", stat_read(bl, writes_issued));
+	seq_printf(m, "write_time_ns:   %llu\n",
+		   (unsigned long long)stat_read(bl, write_time));
+	seq_printf(m, "updates:         %lu\n", stat_read(bl, updates));
+	seq_printf(m, "update_time_ns:  %llu\n",
+		   (unsigned long long)stat_read(bl, update_time));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+static int write_latency_show(struct seq_file *m, void *unused)
+{
+	struct samsung_bl *bl = m->private;
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		seq_printf(m, "< %10llu ns: %lu\n", 1ULL << i,
+			   stat_read(bl, write_latency[i]));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(write_latency);
+
+static int update_latency_show(struct seq_file *m, void *unused)
+{
+	struct samsung_bl *bl = m->private;
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		seq_printf(m, "< %10llu ns: %lu\n", 1ULL << i,
+			   stat_read(bl, update_latency[i]));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(update_latency);
+
+static int time_at_level_show(struct seq_file *m, void *unused)
+{
+	struct samsung_bl *bl = m->private;
+	unsigned long flags;
+	unsigned int level;
+	ktime_t since;
+	bool valid;
+	u8 current_level;
+	u64 ns;
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	valid = hw_cache_valid(bl->hw_cache) && bl->hw_since;
+	current_level = hw_to_user(hw_cache_value(bl->hw_cache));
+	since = bl->hw_since;
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	for (level = 0; level < levels; level++) {
+		ns = stat_read(bl, time_at_level[level]);
+		/* the time spent at the current level is not accounted yet */
+		if (valid && level == current_level)
+			ns += ktime_to_ns(ktime_sub(ktime_get(), since));
+		seq_printf(m, "%3u: %llu ms\n", level,
+			   (unsigned long long)div_u64(ns, NSEC_PER_MSEC));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(time_at_level);
+
+static int last_writer_show(struct seq_file *m, void *unused)
+{
+	struct samsung_bl *bl = m->private;
+	char comm[TASK_COMM_LEN];
+	unsigned long flags;
+	pid_t pid;
+
+	spin_lock_irqsave(&bl->last_writer_lock, flags);
+	pid = bl->last_writer_pid;
+	memcpy(comm, bl->last_writer_comm, sizeof(comm));
+	spin_unlock_irqrestore(&bl->last_writer_lock, flags);
+
+	seq_printf(m, "%d %s\n", pid, comm);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(last_writer);
+
+static struct dentry *debugfs_dir;
+
+/* one directory per backlight, named after it */
+static void samsung_debugfs_add(struct samsung_bl *bl)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir(dev_name(&bl->bd->dev), debugfs_dir);
+	debugfs_create_file("stats", S_IRUSR, dir, bl, &stats_fops);
+	debugfs_create_file("write_latency", S_IRUSR, dir, bl,
+			    &write_latency_fops);
+	debugfs_create_file("update_latency", S_IRUSR, dir, bl,
+			    &update_latency_fops);
+	debugfs_create_file("time_at_level", S_IRUSR, dir, bl,
+			    &time_at_level_fops);
+	debugfs_create_file("last_writer", S_IRUSR, dir, bl,
+			    &last_writer_fops);
+	bl->debugfs_dir = dir;
+}
+
+static int __init dmi_check_cb(const struct dmi_system_id *id)
+{
+	printk(KERN_INFO KBUILD_MODNAME ": found laptop model '%s'\n",
+		id->ident);
+	if (id->driver_data)
+		model = id->driver_data;
+	return 0;
+}
+
+static struct dmi_system_id __initdata samsung_dmi_table[] = {
+	{
+		.ident = "N120",
+		.matches = {
+			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
+			DMI_MATCH(DMI_PRODUCT_NAME, "N120"),
+			DMI_MATCH(DMI_BOARD_NAME, "N120"),
+		},
+		.callback = dmi_check_cb,
+		.driver_data = (void *)&samsung_legacy,
+	},
+	{
+		.ident = "N130",
+		.matches = {
+			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
+			DMI_MATCH(DMI_PRODUCT_NAME, "N130"),
+			DMI_MATCH(DMI_BOARD_NAME, "N130"),
+		},
+		.callback = dmi_check_cb,
+		.driver_data = (void *)&samsung_legacy,
+	},
+	{
+		.ident = "NC10",
+		.matches = {
+			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
+			DMI_MATCH(DMI_PRODUCT_NAME, "NC10"),
+			DMI_MATCH(DMI_BOARD_NAME, "NC10"),
+		},
+		.callback = dmi_check_cb,
+		.driver_data = (void *)&samsung_legacy,
+	},
+	{
+		.ident = "NP-Q45",
+		.matches = {
+			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
+			DMI_MATCH(DMI_PRODUCT_NAME, "SQ45S70S"),
+			DMI_MATCH(DMI_BOARD_NAME, "SQ45S70S"),
+		},
+		.callback = dmi_check_cb,
+		.driver_data = (void *)&samsung_legacy,
+	},
+	{ },
+};
+
+/*
+ * The register offset can be changed through /sys/module/.../offset while we
+ * are running, which is handy for trying out new models.  The new value is
+ * checked, handed to every backlight under its hw_lock so no access ever sees
+ * half of a change, and the brightness is read back from the new register
+ * once, and announced if that is a different level.  -1 goes back to what the
+ * model wants.
+ */
+static void set_offset(struct samsung_bl *bl, int new_offset)
+{
+	struct backlight_device *bd = bl->bd;
+	unsigned long flags;
+	unsigned int level;
+	bool moved;
+
+	stop_animation(bl);
+	hrtimer_cancel(&bl->ramp_timer);
+
+	spin_lock_irqsave(&bl->hw_lock, flags);
+	bl->offset = new_offset;
+	WRITE_ONCE(bl->hw_cache, 0);
+	spin_unlock_irqrestore(&bl->hw_lock, flags);
+
+	mutex_lock(&bd->ops_lock);
+	level = read_brightness(bl);
+	moved = level != bd->props.brightness;
+	bd->props.brightness = level;
+	mutex_unlock(&bd->ops_lock);
+
+	if (moved)
+		notify_brightness(bd);
+}
+
+static int offset_set(const char *val, const struct kernel_param *kp)
+{
+	struct samsung_bl *bl;
+	int new_offset;
+	int retval;
+
+	retval = kstrtoint(val, 0, &new_offset);
+	if (retval)
+		return retval;
+	if (new_offset != -1 &&
+	    (new_offset < MIN_OFFSET || new_offset > MAX_OFFSET))
+		return -EINVAL;
+
+	mutex_lock(&samsung_lock);
+	if (new_offset == -1 && model)
+		new_offset = model->offset;
+	offset = new_offset;
+	list_for_each_entry(bl, &samsung_devices, list)
+		set_offset(bl, new_offset);
+	mutex_unlock(&samsung_lock);
+
+	return 0;
+}
+
+static const struct kernel_param_ops offset_ops = {
+	.set	= offset_set,
+	.get	= param_get_int,
+};
+module_param_cb(offset, &offset_ops, &offset, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(offset, "The offset into the PCI device for the brightness control (-1 = model default)");
+
+/*
+ * Automatic brightness from an ambient light sensor.  If 'als_channel' names
+ * an IIO light channel mapped to us, we sample it every 'als_interval_ms'
+ * from a deferrable work item, so we never wake up an idle CPU just for this.
+ * The readings are smoothed with a simple exponential filter, mapped linearly
+ * onto the brightness levels up to 'als_max_lux', and a new level only wins
+ * once the light has moved a quarter of a level past the boundary, so we do
+ * not flicker between two levels.  The hardware is only written when the
+ * level really changes.  Userspace can still set the brightness, but the
+ * sensor takes over again at the next change in light.
+ */
+#define ALS_SHIFT	4	/* fixed point bits for the filter */
+#define ALS_WEIGHT	2	/* each sample counts for 1/4 */
+#define ALS_MAX_LUX	100000	/* direct sunlight, keeps the maths in an int */
+
+static char *als_channel = "";
+module_param(als_channel, charp, S_IRUGO);
+MODULE_PARM_DESC(als_channel, "IIO ambient light channel to drive the brightness from (empty = off)");
+
+static unsigned int als_interval_ms = 500;
+module_param(als_interval_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(als_interval_ms, "Ambient light sampling interval in milliseconds");
+
+static unsigned int als_max_lux = 1000;
+module_param(als_max_lux, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(als_max_lux, "Ambient light level in lux that maps to full brightness, 1-100000");
+
+static struct iio_channel *als;
+static struct delayed_work als_work;
+static int als_filtered = -1;
+static int als_level = -1;
+
+static int lux_to_level(int lux, unsigned int max_lux)
+{
+	lux = clamp(lux, 0, (int)max_lux);
+	return DIV_ROUND_CLOSEST(lux * (levels - 1), max_lux);
+}
+
+static void als_schedule(void)
+{
+	queue_delayed_work(system_power_efficient_wq, &als_work,
+			   msecs_to_jiffies(max(als_interval_ms, 10U)));
+}
+
+static void als_poll(struct work_struct *work)
+{
+	unsigned int max_lux = clamp(als_max_lux, 1U, ALS_MAX_LUX);
+	struct samsung_bl *bl;
+	int margin;
+	int level;
+	int lux;
+
+	if (iio_read_channel_processed(als, &lux) < 0)
+		goto out;
+
+	lux = clamp(lux, 0, ALS_MAX_LUX) << ALS_SHIFT;
+	if (als_filtered < 0)
+		als_filtered = lux;
+	else
+		als_filtered += (lux - als_filtered) >> ALS_WEIGHT;
+	lux = als_filtered >> ALS_SHIFT;
+
+	level = lux_to_level(lux, max_lux);
+	if (als_level >= 0 && level != als_level) {
+		/* make it clear the boundary by a quarter of a level */
+		margin = max_lux / ((levels - 1) * 4);
+		level = lux_to_level(level > als_level ? lux - margin :
+							 lux + margin, max_lux);
+	}
+	if (level == als_level)
+		goto out;
+	als_level = level;
+
+	/* the same path a write to the brightness file takes */
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list)
+		backlight_device_set_brightness(bl->bd, level);
+	mutex_unlock(&samsung_lock);
+
+out:
+	als_schedule();
+}
+
+static void als_start(struct device *dev)
+{
+	if (!als_channel || !*als_channel)
+		return;
+
+	als = iio_channel_get(dev, als_channel);
+	if (IS_ERR(als)) {
+		printk(KERN_WARNING KBUILD_MODNAME
+			": can not get light channel '%s' (%ld), no auto brightness\n",
+			als_channel, PTR_ERR(als));
+		als = NULL;
+		return;
+	}
+
+	INIT_DEFERRABLE_WORK(&als_work, als_poll);
+	als_filtered = -1;
+	als_level = -1;
+	als_schedule();
+}
+
+static void als_stop(void)
+{
+	if (!als)
+		return;
+	cancel_delayed_work_sync(&als_work);
+	iio_channel_release(als);
+	als = NULL;
+}
+
+/*
+ * Idle dimming.  With 'idle_timeout' set when the driver loads, we watch all
+ * keyboards, mice, touchpads and touchscreens, but not things like
+ * accelerometers that report all the time, and when none of them has done
+ * anything for
+ * that many seconds the panel is dimmed to 'idle_level'.  The first input
+ * after that brings the old level straight back.  Only the hardware is
+ * dimmed, the brightness userspace sees stays where it was.  Levels set while
+ * we are dimmed, by userspace or by the driver itself, are held down to
+ * 'idle_level' and come back along with everything else.
+ *
+ * The input event path only notes the time, the actual checking is done from
+ * a deferrable work item so an idle machine is not woken up for it.
+ */
+static unsigned int idle_timeout;
+module_param(idle_timeout, uint, S_IRUGO);
+MODULE_PARM_DESC(idle_timeout, "Seconds without input before dimming the panel (0 = never)");
+
+static unsigned int idle_level;
+module_param(idle_level, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(idle_level, "Brightness level to dim to when idle");
+
+/*
+ * Brightness keys.  With 'hotkeys' set the driver steps the level itself on
+ * KEY_BRIGHTNESSUP/DOWN instead of waiting for the key to make its way
+ * through the desktop to sysfs.  Userspace still gets the key, and is told
+ * about the new level, so its own handling of these keys should be turned
+ * off or every press counts twice.  Presses are added up in the event path
+ * and handed to a work item, which does the write through the usual path.
+ * With only this turned on we just listen to devices that have the keys.
+ */
+static bool hotkeys;
+module_param(hotkeys, bool, S_IRUGO);
+MODULE_PARM_DESC(hotkeys, "Handle the brightness keys in the driver");
+
+static struct delayed_work idle_work;
+static struct work_struct idle_restore_work;
+static unsigned long idle_last;
+static bool idle_dimmed;		/* protected by samsung_lock */
+static struct work_struct hotkey_work;
+static atomic_t hotkey_steps;
+static bool input_registered;
+/* keeps the event path from queueing work while we are suspended */
+static DEFINE_SPINLOCK(input_lock);
+static bool input_suspended;		/* protected by input_lock */
+
+static void idle_schedule(unsigned long delay)
+{
+	queue_delayed_work(system_power_efficient_wq, &idle_work, delay);
+}
+
+static void idle_check(struct work_struct *work)
+{
+	unsigned long deadline = READ_ONCE(idle_last) + idle_timeout * HZ;
+	struct samsung_bl *bl;
+	u8 level;
+
+	if (time_before(jiffies, deadline)) {
+		idle_schedule(deadline - jiffies);
+		return;
+	}
+
+	mutex_lock(&samsung_lock);
+	level = min(idle_level, levels - 1);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		WRITE_ONCE(bl->idle_cap, level);
+		/* a write queued before the cap must not land after us */
+		flush_delayed_work(&bl->coalesce_work);
+		apply_brightness(bl, bl->bd->props.brightness);
+	}
+	WRITE_ONCE(idle_dimmed, true);
+	mutex_unlock(&samsung_lock);
+}
+
+static void idle_restore(struct work_struct *work)
+{
+	struct samsung_bl *bl;
+
+	mutex_lock(&samsung_lock);
+	if (idle_dimmed) {
+		/* no fading in, someone is looking at the screen */
+		list_for_each_entry(bl, &samsung_devices, list) {
+			WRITE_ONCE(bl->idle_cap, -1);
+			__apply_brightness(bl, bl->bd->props.brightness, 0);
+		}
+		WRITE_ONCE(idle_dimmed, false);
+	}
+	mutex_unlock(&samsung_lock);
+
+	idle_schedule(idle_timeout * HZ);
+}
+
+static void hotkey_step(struct work_struct *work)
+{
+	struct backlight_device *bd;
+	struct samsung_bl *bl;
+	bool moved;
+	int steps;
+	int level;
+
+	steps = atomic_xchg(&hotkey_steps, 0);
+	if (!steps)
+		return;
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		bd = bl->bd;
+
+		/* what backlight_device_set_brightness() does, as one step */
+		mutex_lock(&bd->ops_lock);
+		level = clamp_t(int, bd->props.brightness + steps,
+				0, levels - 1);
+		moved = level != bd->props.brightness;
+		if (moved) {
+			bd->props.brightness = level;
+			backlight_update_status(bd);
+		}
+		mutex_unlock(&bd->ops_lock);
+
+		if (moved)
+			notify_brightness(bd);
+	}
+	mutex_unlock(&samsung_lock);
+}
+
+/* called with the device's event_lock held and interrupts off */
+static void samsung_input_event(struct input_handle *handle,
+				unsigned int type, unsigned int code, int value)
+{
+	spin_lock(&input_lock);
+	if (input_suspended)
+		goto out;
+
+	WRITE_ONCE(idle_last, jiffies);
+	if (READ_ONCE(idle_dimmed))
+		queue_work(system_highpri_wq, &idle_restore_work);
+
+	/* presses and autorepeat, not releases */
+	if (!hotkeys || type != EV_KEY || !value)
+		goto out;
+	if (code == KEY_BRIGHTNESSUP)
+		atomic_add(1, &hotkey_steps);
+	else if (code == KEY_BRIGHTNESSDOWN)
+		atomic_add(-1, &hotkey_steps);
+	else
+		goto out;
+	queue_work(system_highpri_wq, &hotkey_work);
+out:
+	spin_unlock(&input_lock);
+}
+
+/* the id table lets in anything we might want, this weeds out the rest */
+static bool samsung_input_match(struct input_handler *handler,
+				struct input_dev *dev)
+{
+	if (idle_timeout)
+		return true;
+	return test_bit(KEY_BRIGHTNESSUP, dev->keybit) ||
+	       test_bit(KEY_BRIGHTNESSDOWN, dev->keybit);
+}
+
+static int samsung_input_connect(struct input_handler *handler,
+				 struct input_dev *dev,
+				 const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int retval;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "samsung-backlight";
+
+	retval = input_register_handle(handle);
+	if (retval)
+		goto error_register;
+
+	retval = input_open_device(handle);
+	if (retval)
+		goto error_open;
+
+	return 0;
+
+error_open:
+	input_unregister_handle(handle);
+error_register:
+	kfree(handle);
+	return retval;
+}
+
+static void samsung_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+#define SAMSUNG_INPUT_KEY(key)						\
+	{								\
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |			\
+			 INPUT_DEVICE_ID_MATCH_KEYBIT,			\
+		.evbit = { BIT_MASK(EV_KEY) },				\
+		.keybit = { [BIT_WORD(key)] = BIT_MASK(key) },		\
+	}
+
+static const struct input_device_id samsung_input_ids[] = {
+	SAMSUNG_INPUT_KEY(KEY_SPACE),		/* keyboards */
+	SAMSUNG_INPUT_KEY(BTN_LEFT),		/* mice and touchpads */
+	SAMSUNG_INPUT_KEY(BTN_TOUCH),		/* touchscreens */
+	SAMSUNG_INPUT_KEY(KEY_BRIGHTNESSUP),
+	SAMSUNG_INPUT_KEY(KEY_BRIGHTNESSDOWN),
+	{ },
+};
+
+static struct input_handler samsung_input_handler = {
+	.event		= samsung_input_event,
+	.match		= samsung_input_match,
+	.connect	= samsung_input_connect,
+	.disconnect	= samsung_input_disconnect,
+	.name		= "samsung-backlight",
+	.id_table	= samsung_input_ids,
+};
+
+static void input_start(void)
+{
+	if (!idle_timeout && !hotkeys)
+		return;
+
+	INIT_DEFERRABLE_WORK(&idle_work, idle_check);
+	INIT_WORK(&idle_restore_work, idle_restore);
+	INIT_WORK(&hotkey_work, hotkey_step);
+	idle_last = jiffies;
+	idle_dimmed = false;
+	input_suspended = false;
+	atomic_set(&hotkey_steps, 0);
+
+	if (input_register_handler(&samsung_input_handler)) {
+		printk(KERN_WARNING KBUILD_MODNAME
+			": can not watch input devices, no idle dimming or hotkeys\n");
+		return;
+	}
+	input_registered = true;
+	if (idle_timeout)
+		idle_schedule(idle_timeout * HZ);
+}
+
+static void input_stop(void)
+{
+	if (!input_registered)
+		return;
+	input_unregister_handler(&samsung_input_handler);
+	cancel_work_sync(&hotkey_work);
+	cancel_work_sync(&idle_restore_work);
+	cancel_delayed_work_sync(&idle_work);
+	input_registered = false;
+}
+
+static void input_suspend(void)
+{
+	if (!input_registered)
+		return;
+
+	/* the handler stays connected, so shut the event path first */
+	spin_lock_irq(&input_lock);
+	input_suspended = true;
+	spin_unlock_irq(&input_lock);
+
+	cancel_work_sync(&hotkey_work);
+	cancel_work_sync(&idle_restore_work);
+	cancel_delayed_work_sync(&idle_work);
+	atomic_set(&hotkey_steps, 0);
+}
+
+static void input_resume(void)
+{
+	if (!input_registered)
+		return;
+
+	idle_last = jiffies;
+	spin_lock_irq(&input_lock);
+	input_suspended = false;
+	spin_unlock_irq(&input_lock);
+
+	if (idle_timeout)
+		idle_schedule(idle_timeout * HZ);
+}
+
 /*
- * HAL/gnome-display-manager really wants us to only set 8 different levels for
- * the brightness control.  And since 256 different levels seems a bit
- * overkill, that's fine.  So let's map the 256 values to 8 different ones:
+ * The Fn brightness keys on these machines are handled by the firmware,
+ * which pokes the register without telling us.  If 'hotkey_poll_ms' is set
+ * we go and look at the register every so often, doubling the interval up
+ * to 'hotkey_poll_max_ms' for as long as nothing changes, and starting over
+ * from the short interval once something does.  A real change is reported
+ * to userspace so nobody has to poll actual_brightness themselves.
+ */
+static unsigned int hotkey_poll_ms;
+module_param(hotkey_poll_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(hotkey_poll_ms, "Shortest interval in milliseconds to check for firmware brightness changes (0 = off)");
+
+static unsigned int hotkey_poll_max_ms = 2000;
+module_param(hotkey_poll_max_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(hotkey_poll_max_ms, "Longest interval in milliseconds to back off to while nothing changes");
+
+static struct delayed_work poll_work;
+static unsigned int poll_interval;
+
+static void poll_schedule(void)
+{
+	queue_delayed_work(system_power_efficient_wq, &poll_work,
+			   msecs_to_jiffies(poll_interval));
+}
+
+static void poll_hw(struct work_struct *work)
+{
+	struct backlight_device *bd;
+	struct samsung_bl *bl;
+	bool changed = false;
+	bool moved;
+	u8 level;
+	u8 hw;
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		bd = bl->bd;
+		moved = false;
+
+		/* keeps brightness stores out while we look */
+		mutex_lock(&bd->ops_lock);
+
+		/* we are the ones moving it right now, leave it be */
+		if (hrtimer_active(&bl->ramp_timer) ||
+		    hrtimer_active(&bl->anim_timer) ||
+		    delayed_work_pending(&bl->coalesce_work))
+			goto next;
+
+		if (!reread_hw(bl, &hw))
+			goto next;
+		changed = true;
+
+		level = hw_to_user(hw);
+		if (level != bd->props.brightness) {
+			bd->props.brightness = level;
+			moved = true;
+		}
+next:
+		mutex_unlock(&bd->ops_lock);
+		if (moved)
+			notify_brightness(bd);
+	}
+	mutex_unlock(&samsung_lock);
+
+	if (changed)
+		poll_interval = hotkey_poll_ms;
+	else
+		poll_interval = min(poll_interval * 2,
+				    max(hotkey_poll_max_ms, hotkey_poll_ms));
+	poll_schedule();
+}
+
+static void poll_start(void)
+{
+	if (!hotkey_poll_ms)
+		return;
+
+	INIT_DEFERRABLE_WORK(&poll_work, poll_hw);
+	poll_interval = hotkey_poll_ms;
+	poll_schedule();
+}
+
+static void poll_stop(void)
+{
+	if (hotkey_poll_ms)
+		cancel_delayed_work_sync(&poll_work);
+}
+
+/*
+ * Power source profiles.  'ac_level' and 'battery_level' pick the brightness
+ * to switch to when the machine goes onto mains power or onto battery, -1
+ * leaves it alone.  'profile_ramp_ms' fades into the new level, 0 uses
+ * 'ramp_ms'.  The power supply notifier is atomic, so it only kicks a work
+ * item that looks at what we are running on now.  Userspace is told about
+ * the new level like it would be for a hotkey.  The notifier is always
+ * there, so levels set at runtime take effect on the next power supply
+ * event.
+ */
+static int ac_level = -1;
+module_param(ac_level, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ac_level, "Brightness level to switch to on mains power (-1 = leave alone)");
+
+static int battery_level = -1;
+module_param(battery_level, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(battery_level, "Brightness level to switch to on battery (-1 = leave alone)");
+
+static unsigned int profile_ramp_ms;
+module_param(profile_ramp_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(profile_ramp_ms, "Time in milliseconds to fade into a power profile level (0 = use ramp_ms)");
+
+static struct work_struct psy_work;
+static int psy_online = -1;
+static bool psy_registered;
+
+static void psy_update(struct work_struct *work)
+{
+	int ac = READ_ONCE(ac_level);
+	int battery = READ_ONCE(battery_level);
+	struct samsung_bl *bl;
+	int online;
+	int level;
+
+	/* psy_online stays put, so setting a level applies at the next event */
+	if (ac < 0 && battery < 0)
+		return;
+
+	online = power_supply_is_system_supplied();
+	if (online < 0 || online == psy_online)
+		return;
+	psy_online = online;
+
+	level = online ? ac : battery;
+	if (level < 0)
+		return;
+	level = min_t(int, level, levels - 1);
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		mutex_lock(&bl->bd->ops_lock);
+		bl->bd->props.brightness = level;
+		stop_animation(bl);
+		drop_coalesced(bl);
+		__apply_brightness(bl, level,
+				   profile_ramp_ms ?: ramp_duration(bl));
+		mutex_unlock(&bl->bd->ops_lock);
+		/* not a sysfs write, and the core has no other reason */
+		notify_brightness(bl->bd);
+	}
+	mutex_unlock(&samsung_lock);
+}
+
+static int psy_notify(struct notifier_block *nb, unsigned long event,
+		      void *data)
+{
+	if (event == PSY_EVENT_PROP_CHANGED)
+		schedule_work(&psy_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block psy_notifier = {
+	.notifier_call = psy_notify,
+};
+
+static void psy_start(void)
+{
+	INIT_WORK(&psy_work, psy_update);
+	psy_online = -1;
+	if (power_supply_reg_notifier(&psy_notifier)) {
+		printk(KERN_WARNING KBUILD_MODNAME
+			": can not watch power supplies, no power profiles\n");
+		return;
+	}
+	psy_registered = true;
+
+	/* pick the right profile for what we are running on right now */
+	schedule_work(&psy_work);
+}
+
+static void psy_stop(void)
+{
+	if (!psy_registered)
+		return;
+	power_supply_unreg_notifier(&psy_notifier);
+	cancel_work_sync(&psy_work);
+	psy_registered = false;
+}
+
+/*
+ * The Samsung N120, N130, and NC10 use pci device id 0x27ae, while the
+ * NP-Q45 uses 0x2a02.  Odds are we might need to add more to the list over
+ * time...
+ */
+static const struct pci_device_id samsung_pci_ids[] = {
+	{ PCI_DEVICE(PCI_VENDOR_ID_INTEL, 0x27ae) },
+	{ PCI_DEVICE(PCI_VENDOR_ID_INTEL, 0x2a02) },
+	{ },
+};
+
+/*
+ * New models do not need a new driver, they can be described in a quirk
+ * database that is loaded with request_firmware() when we probe.  The file
+ * is a header followed by a number of fixed size records, all integers are
+ * little endian:
  *
- * userspace	 0    1    2    3    4    5    6    7
- * hardware	31   63   95  127  159  195  223  255
+ *	header:	"SBLQ", u16 version (1), u16 number of records
+ *	record:	char sys_vendor[32], product_name[32], board_name[32]
+ *		u16 PCI vendor, u16 PCI device, u16 levels,
+ *		u8 register offset, u8 curve
  *
- * or hardware = ((userspace + 1) * 32)-1
+ * The DMI strings are NUL padded, an empty one matches anything.  The first
+ * record that matches the machine wins, and wins over the built-in table.
  *
- * Note, we keep value 0 at a positive value, otherwise the screen goes
- * blank because HAL likes to set the backlight to 0 at startup when there is
- * no power plugged in.
+ * The module is only loaded automatically on the models in the built-in
+ * table, one that is only in the quirk database has to be loaded by hand.
  */
+static char *quirks = "samsung-backlight-quirks.bin";
+module_param(quirks, charp, S_IRUGO);
+MODULE_PARM_DESC(quirks, "Name of the firmware file holding the model quirk database");
+MODULE_FIRMWARE("samsung-backlight-quirks.bin");
+
+#define QUIRK_MAGIC	"SBLQ"
+#define QUIRK_VERSION	1
+#define QUIRK_DMI_LEN	32
 
+struct samsung_quirk_header {
+	char	magic[4];
+	__le16	version;
+	__le16	count;
+} __packed;
 
-static int offset = OFFSET;
-module_param(offset, int, S_IRUGO | S_IWUSR);
-MODULE_PARM_DESC(offset, "The offset into the PCI device for the brightness control");
+struct samsung_quirk_record {
+	char	sys_vendor[QUIRK_DMI_LEN];
+	char	product_name[QUIRK_DMI_LEN];
+	char	board_name[QUIRK_DMI_LEN];
+	__le16	pci_vendor;
+	__le16	pci_device;
+	__le16	levels;
+	u8	offset;
+	u8	curve;
+} __packed;
 
-static struct pci_dev *pci_device;
-static struct backlight_device *backlight_device;
+/* the model that came out of the quirk database, if any */
+static struct samsung_model *quirk_model;
 
-static u8 read_brightness(void)
+static bool quirk_string_ok(const char *str)
 {
-	u8 kernel_brightness;
-	u8 user_brightness = 0;
+	return memchr(str, '\0', QUIRK_DMI_LEN) != NULL;
+}
 
-	pci_read_config_byte(pci_device, offset, &kernel_brightness);
-	user_brightness = ((kernel_brightness + 1) / 32) - 1;
-	return user_brightness;
+static bool quirk_dmi_match(enum dmi_field field, const char *str)
+{
+	return !*str || dmi_match(field, str);
 }
 
-static void set_brightness(u8 user_brightness)
+static int quirk_record_parse(const struct samsung_quirk_record *rec,
+			      struct samsung_model *m)
 {
-	u16 kernel_brightness = 0;
+	if (!quirk_string_ok(rec->sys_vendor) ||
+	    !quirk_string_ok(rec->product_name) ||
+	    !quirk_string_ok(rec->board_name))
+		return -EINVAL;
 
-	kernel_brightness = ((user_brightness + 1) * 32) - 1;
-	pci_write_config_byte(pci_device, offset, (u8)kernel_brightness);
+	m->offset = rec->offset;
+	m->levels = le16_to_cpu(rec->levels);
+	m->curve = rec->curve;
+	m->pci_vendor = le16_to_cpu(rec->pci_vendor);
+	m->pci_device = le16_to_cpu(rec->pci_device);
+	if (m->offset < MIN_OFFSET || m->levels < 2 ||
+	    m->levels > MAX_USER_LEVELS || m->curve >= CURVE_MAX)
+		return -EINVAL;
+	m->curves[CURVE_GAMMA22] = curve_gamma22;
+	m->curves[CURVE_CIE1931] = curve_cie1931;
+	return 0;
 }
 
-static int get_brightness(struct backlight_device *bd)
+static int load_quirks(struct device *dev)
 {
-	return bd->props.brightness;
+	const struct samsung_quirk_header *hdr;
+	const struct samsung_quirk_record *rec;
+	const struct firmware *fw;
+	struct samsung_model *m;
+	unsigned int count;
+	unsigned int i;
+
+	/* already parsed on an earlier probe */
+	if (quirk_model || !quirks || !*quirks)
+		return 0;
+
+	/* not having a database at all is perfectly normal */
+	if (firmware_request_nowarn(&fw, quirks, dev))
+		return 0;
+
+	hdr = (const struct samsung_quirk_header *)fw->data;
+	if (fw->size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, QUIRK_MAGIC, sizeof(hdr->magic)) ||
+	    le16_to_cpu(hdr->version) != QUIRK_VERSION)
+		goto bad;
+	count = le16_to_cpu(hdr->count);
+	if (fw->size < sizeof(*hdr) + count * sizeof(*rec))
+		goto bad;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m) {
+		release_firmware(fw);
+		return -ENOMEM;
+	}
+
+	rec = (const struct samsung_quirk_record *)(hdr + 1);
+	for (i = 0; i < count; i++, rec++) {
+		if (quirk_record_parse(rec, m)) {
+			kfree(m);
+			goto bad;
+		}
+		if (quirk_dmi_match(DMI_SYS_VENDOR, rec->sys_vendor) &&
+		    quirk_dmi_match(DMI_PRODUCT_NAME, rec->product_name) &&
+		    quirk_dmi_match(DMI_BOARD_NAME, rec->board_name)) {
+			printk(KERN_INFO KBUILD_MODNAME
+				": found laptop model '%s' in %s\n",
+				rec->product_name, quirks);
+			quirk_model = m;
+			model = m;
+			release_firmware(fw);
+			return 0;
+		}
+	}
+
+	kfree(m);
+	release_firmware(fw);
+	return 0;
+
+bad:
+	printk(KERN_ERR KBUILD_MODNAME ": ignoring corrupt quirk database %s\n",
+		quirks);
+	release_firmware(fw);
+	return 0;
 }
 
-static int update_status(struct backlight_device *bd)
+/* work out the levels, curve and offset once we know which model this is */
+static int setup_model(void)
 {
-	set_brightness(bd->props.brightness);
+	int retval;
+
+	if (offset < 0)
+		offset = model->offset;
+
+	if (!levels)
+		levels = model->levels;
+	if (levels < 2 || levels > MAX_USER_LEVELS) {
+		printk(KERN_ERR KBUILD_MODNAME ": invalid number of levels %u\n",
+			levels);
+		return -EINVAL;
+	}
+	if (curve && *curve) {
+		retval = find_curve(curve);
+		if (retval < 0) {
+			printk(KERN_ERR KBUILD_MODNAME ": unknown curve '%s'\n",
+				curve);
+			return retval;
+		}
+	} else {
+		retval = model->curve;
+	}
+	build_level_tables(levels, model->curves[retval]);
 	return 0;
 }
 
-static struct backlight_ops backlight_ops = {
-	.get_brightness	= get_brightness,
-	.update_status	= update_status,
-};
+static void samsung_bl_destroy(struct samsung_bl *bl)
+{
+	debugfs_remove_recursive(bl->debugfs_dir);
+	sysfs_remove_group(&bl->bd->dev.kobj, &samsung_attr_group);
+	stop_animation(bl);
+	cancel_work_sync(&bl->anim_work);
+	backlight_device_unregister(bl->bd);
+	cancel_delayed_work_sync(&bl->coalesce_work);
+	hrtimer_cancel(&bl->ramp_timer);
 
-static int __init dmi_check_cb(const struct dmi_system_id *id)
+	if (bl->reg_ops->release)
+		bl->reg_ops->release(bl);
+	/* we are done with the PCI device, put it back */
+	if (bl->link)
+		device_link_del(bl->link);
+	pci_dev_put(bl->pci_device);
+	kfree(bl->anim_frames);
+	free_percpu(bl->stats);
+	kfree(bl);
+}
+
+/*
+ * Set up a backlight for one PCI device, or for a loopback register file if
+ * pci_device is NULL.  The first one gets the traditional "samsung" name, any
+ * others get a number tacked onto it.  Takes over the reference to
+ * pci_device, also if it fails.
+ */
+static int samsung_bl_create(struct platform_device *pdev,
+			     struct pci_dev *pci_device, int index)
 {
-	printk(KERN_INFO KBUILD_MODNAME ": found laptop model '%s'\n",
-		id->ident);
+	struct device *parent = pci_device ? &pci_device->dev : &pdev->dev;
+	struct backlight_properties props;
+	struct samsung_bl *bl;
+	char name[16];
+	int retval = -ENOMEM;
+
+	bl = kzalloc(sizeof(*bl), GFP_KERNEL);
+	if (!bl)
+		goto error_alloc;
+	bl->stats = alloc_percpu(struct samsung_stats);
+	if (!bl->stats)
+		goto error_stats;
+
+	bl->pci_device = pci_device;
+	/*
+	 * We get suspended and resumed asynchronously, and the graphics
+	 * driver may well be too, so nothing says the PCI device is still up
+	 * when we save the level, or back up when we write it out again.
+	 */
+	if (pci_device) {
+		bl->link = device_link_add(&pdev->dev, &pci_device->dev,
+					   DL_FLAG_STATELESS);
+		if (!bl->link)
+			goto error_link;
+	}
+	bl->reg_ops = find_reg_ops(pci_device);
+	bl->offset = offset;
+	if (!bl->reg_ops) {
+		printk(KERN_ERR KBUILD_MODNAME
+		       ": register backend for this model not built in\n");
+		retval = -ENODEV;
+		goto error_regs;
+	}
+	if (bl->reg_ops->setup) {
+		retval = bl->reg_ops->setup(bl);
+		if (retval)
+			goto error_regs;
+	}
+	bl->ramp_ms = -1;
+	bl->idle_cap = -1;
+	spin_lock_init(&bl->hw_lock);
+	spin_lock_init(&bl->coalesce_lock);
+	spin_lock_init(&bl->last_writer_lock);
+	samsung_hrtimer_setup(&bl->ramp_timer, ramp_step,
+			      HRTIMER_MODE_REL_SOFT);
+	INIT_DELAYED_WORK(&bl->coalesce_work, coalesce_flush);
+	mutex_init(&bl->anim_lock);
+	samsung_hrtimer_setup(&bl->anim_timer, anim_step,
+			      HRTIMER_MODE_ABS_SOFT);
+	INIT_WORK(&bl->anim_work, anim_report);
+	bl->anim_level = -1;
+
+	if (index)
+		snprintf(name, sizeof(name), "samsung-%d", index);
+	else
+		strcpy(name, "samsung");
+
+	memset(&props, 0, sizeof(struct backlight_properties));
+
+	/* create a backlight device to talk to this one */
+	bl->bd = backlight_device_register(name, parent, bl,
+					   &backlight_ops, &props);
+	if (IS_ERR(bl->bd)) {
+		retval = PTR_ERR(bl->bd);
+		goto error_register;
+	}
+
+	bl->bd->props.max_brightness = levels - 1;
+	/*
+	 * No need to write this back out, the shadow register now holds what
+	 * the hardware has, and the next real change will go through it.
+	 */
+	bl->bd->props.brightness = read_brightness(bl);
+	bl->bd->props.power = FB_BLANK_UNBLANK;
+
+	retval = sysfs_create_group(&bl->bd->dev.kobj, &samsung_attr_group);
+	if (retval)
+		goto error_sysfs;
+
+	samsung_debugfs_add(bl);
+
+	mutex_lock(&samsung_lock);
+	/* catch up with an offset change that raced with us */
+	if (bl->offset != offset)
+		set_offset(bl, offset);
+	list_add_tail(&bl->list, &samsung_devices);
+	mutex_unlock(&samsung_lock);
+
 	return 0;
+
+error_sysfs:
+	backlight_device_unregister(bl->bd);
+	cancel_delayed_work_sync(&bl->coalesce_work);
+	hrtimer_cancel(&bl->ramp_timer);
+error_register:
+	if (bl->reg_ops->release)
+		bl->reg_ops->release(bl);
+error_regs:
+	if (bl->link)
+		device_link_del(bl->link);
+error_link:
+	free_percpu(bl->stats);
+error_stats:
+	kfree(bl);
+error_alloc:
+	pci_dev_put(pci_device);
+	return retval;
 }
 
-static struct dmi_system_id __initdata samsung_dmi_table[] = {
-	{
-		.ident = "N120",
-		.matches = {
-			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
-			DMI_MATCH(DMI_PRODUCT_NAME, "N120"),
-			DMI_MATCH(DMI_BOARD_NAME, "N120"),
-		},
-		.callback = dmi_check_cb,
-	},
-	{
-		.ident = "N130",
-		.matches = {
-			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
-			DMI_MATCH(DMI_PRODUCT_NAME, "N130"),
-			DMI_MATCH(DMI_BOARD_NAME, "N130"),
-		},
-		.callback = dmi_check_cb,
-	},
-	{
-		.ident = "NC10",
-		.matches = {
-			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
-			DMI_MATCH(DMI_PRODUCT_NAME, "NC10"),
-			DMI_MATCH(DMI_BOARD_NAME, "NC10"),
-		},
-		.callback = dmi_check_cb,
-	},
-	{
-		.ident = "NP-Q45",
-		.matches = {
-			DMI_MATCH(DMI_SYS_VENDOR, "SAMSUNG ELECTRONICS CO., LTD."),
-			DMI_MATCH(DMI_PRODUCT_NAME, "SQ45S70S"),
-			DMI_MATCH(DMI_BOARD_NAME, "SQ45S70S"),
-		},
-		.callback = dmi_check_cb,
+static void samsung_remove_all(void)
+{
+	struct samsung_bl *bl, *next;
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry_safe(bl, next, &samsung_devices, list) {
+		list_del(&bl->list);
+		samsung_bl_destroy(bl);
+	}
+	mutex_unlock(&samsung_lock);
+}
+
+/*
+ * The PCI devices we poke at are the integrated graphics functions, which
+ * belong to the graphics driver, so we can not bind to them ourselves.
+ * Instead we hang a platform device off of the driver core and do all of the
+ * real work in its probe function, which the driver core is free to run
+ * asynchronously so that we never hold up boot or module loading.
+ *
+ * Every matching PCI device gets a backlight of its own.
+ */
+static int samsung_probe(struct platform_device *pdev)
+{
+	const struct pci_device_id *ids = samsung_pci_ids;
+	struct pci_device_id model_ids[2];
+	const struct pci_device_id *id;
+	struct pci_dev *pci_device;
+	int count = 0;
+	int retval;
+
+	retval = load_quirks(&pdev->dev);
+	if (retval)
+		return retval;
+	if (!model && loopback)
+		model = &samsung_legacy;
+	if (!model)
+		return -ENODEV;
+
+	retval = setup_model();
+	if (retval)
+		return retval;
+
+	if (loopback) {
+		for (count = 0; count < loopback; count++) {
+			retval = samsung_bl_create(pdev, NULL, count);
+			if (retval) {
+				samsung_remove_all();
+				return retval;
+			}
+		}
+		goto done;
+	}
+
+	if (model->pci_vendor) {
+		memset(model_ids, 0, sizeof(model_ids));
+		model_ids[0].vendor = model->pci_vendor;
+		model_ids[0].device = model->pci_device;
+		ids = model_ids;
+	}
+
+	for (id = ids; id->vendor; id++) {
+		pci_device = NULL;
+		while ((pci_device = pci_get_device(id->vendor, id->device,
+						    pci_device))) {
+			/* the create call owns the reference from here on */
+			retval = samsung_bl_create(pdev, pci_dev_get(pci_device),
+						   count);
+			if (retval) {
+				pci_dev_put(pci_device);
+				samsung_remove_all();
+				return retval;
+			}
+			count++;
+		}
+	}
+	if (!count)
+		return -ENODEV;
+
+done:
+	device_enable_async_suspend(&pdev->dev);
+	als_start(&pdev->dev);
+	input_start();
+	psy_start();
+	poll_start();
+
+	return 0;
+}
+
+static void __samsung_remove(struct platform_device *pdev)
+{
+	/* the loops below walk the device list, stop them first */
+	poll_stop();
+	psy_stop();
+	input_stop();
+	als_stop();
+	samsung_remove_all();
+}
+
+/* platform_driver.remove lost its return value in 6.11 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+static void samsung_remove(struct platform_device *pdev)
+{
+	__samsung_remove(pdev);
+}
+#else
+static int samsung_remove(struct platform_device *pdev)
+{
+	__samsung_remove(pdev);
+	return 0;
+}
+#endif
+
+/*
+ * The firmware does what it likes with the register over a suspend, so on the
+ * way down remember the level we were last asked for, and on the way back up
+ * write it out again.  That is one config write, and no reads, as we already
+ * know what the value should be.  The resume side is allowed to run
+ * asynchronously so it stays off of the critical resume path, the device
+ * links from samsung_bl_create() keep it behind the PCI devices we write to.
+ */
+static int samsung_suspend(struct device *dev)
+{
+	struct samsung_bl *bl;
+
+	if (als)
+		cancel_delayed_work_sync(&als_work);
+	input_suspend();
+	if (psy_registered)
+		cancel_work_sync(&psy_work);
+	poll_stop();
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		/* stop anything in flight, we restore the final level anyway */
+		stop_animation(bl);
+		cancel_delayed_work_sync(&bl->coalesce_work);
+		hrtimer_cancel(&bl->ramp_timer);
+
+		bl->saved_hw = user_to_hw(bl->bd->props.brightness);
+	}
+	mutex_unlock(&samsung_lock);
+	return 0;
+}
+
+static int samsung_resume(struct device *dev)
+{
+	struct samsung_bl *bl;
+
+	mutex_lock(&samsung_lock);
+	list_for_each_entry(bl, &samsung_devices, list) {
+		/* whatever the shadow register says, the hardware may not agree */
+		WRITE_ONCE(bl->idle_cap, -1);
+		invalidate_hw(bl);
+		write_hw(bl, bl->saved_hw);
+	}
+	/* which also undid any idle dimming */
+	WRITE_ONCE(idle_dimmed, false);
+	mutex_unlock(&samsung_lock);
+
+	if (als)
+		als_schedule();
+	input_resume();
+	/* we may have been plugged in or out while asleep */
+	if (psy_registered)
+		schedule_work(&psy_work);
+	if (hotkey_poll_ms) {
+		poll_interval = hotkey_poll_ms;
+		poll_schedule();
+	}
+	return 0;
+}
+
+static const struct dev_pm_ops samsung_pm_ops = {
+	.suspend	= samsung_suspend,
+	.resume		= samsung_resume,
+	.freeze		= samsung_suspend,
+	.thaw		= samsung_resume,
+	.poweroff	= samsung_suspend,
+	.restore	= samsung_resume,
+};
+
+static struct platform_driver samsung_driver = {
+	.probe		= samsung_probe,
+	.remove		= samsung_remove,
+	.driver		= {
+		.name		= "samsung-backlight",
+		.owner		= THIS_MODULE,
+		.pm		= &samsung_pm_ops,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
-	{ },
 };
 
+static struct platform_device *samsung_device;
+
 static int __init samsung_init(void)
 {
-	struct backlight_properties props;
-	memset(&props, 0, sizeof(struct backlight_properties));
-
-	if (!dmi_check_system(samsung_dmi_table))
-		return -ENODEV;
+	int retval;
 
 	/*
-	 * The Samsung N120, N130, and NC10 use pci device id 0x27ae, while the
-	 * NP-Q45 uses 0x2a02.  Odds are we might need to add more to the
-	 * list over time...
+	 * Models that are not in the table above may still be in the quirk
+	 * database, but reading that is left to the asynchronous probe, so
+	 * all we can turn down here is a machine with nothing to look at.
 	 */
-	pci_device = pci_get_device(PCI_VENDOR_ID_INTEL, 0x27ae, NULL);
-	if (!pci_device) {
-		pci_device = pci_get_device(PCI_VENDOR_ID_INTEL, 0x2a02, NULL);
-		if (!pci_device)
-			return -ENODEV;
-	}
+	if (!dmi_check_system(samsung_dmi_table) && !loopback &&
+	    (!quirks || !*quirks))
+		return -ENODEV;
 
-	/* create a backlight device to talk to this one */
-	backlight_device = backlight_device_register("samsung",
-						     &pci_device->dev,
-						     NULL, &backlight_ops, &props);
-	if (IS_ERR(backlight_device)) {
-		pci_dev_put(pci_device);
-		return PTR_ERR(backlight_device);
+	debugfs_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+
+	retval = platform_driver_register(&samsung_driver);
+	if (retval) {
+		debugfs_remove_recursive(debugfs_dir);
+		return retval;
 	}
 
-	backlight_device->props.max_brightness = MAX_BRIGHT;
-	backlight_device->props.brightness = read_brightness();
-	backlight_device->props.power = FB_BLANK_UNBLANK;
-	backlight_update_status(backlight_device);
+	samsung_device = platform_device_register_simple("samsung-backlight",
+							 -1, NULL, 0);
+	if (IS_ERR(samsung_device)) {
+		platform_driver_unregister(&samsung_driver);
+		debugfs_remove_recursive(debugfs_dir);
+		return PTR_ERR(samsung_device);
+	}
 
 	return 0;
 }
 
 static void __exit samsung_exit(void)
 {
-	backlight_device_unregister(backlight_device);
-
-	/* we are done with the PCI device, put it back */
-	pci_dev_put(pci_device);
+	platform_device_unregister(samsung_device);
+	platform_driver_unregister(&samsung_driver);
+	debugfs_remove_recursive(debugfs_dir);
+	kfree(quirk_model);
 }
 
 module_init(samsung_init);
@@ -180,3 +2540,7 @@ MODULE_ALIAS("dmi:*:svnSAMSUNGELECTRONICSCO.,LTD.:pnN120:*:rnN120:*");
 MODULE_ALIAS("dmi:*:svnSAMSUNGELECTRONICSCO.,LTD.:pnN130:*:rnN130:*");
 MODULE_ALIAS("dmi:*:svnSAMSUNGELECTRONICSCO.,LTD.:pnNC10:*:rnNC10:*");
 MODULE_ALIAS("dmi:*:svnSAMSUNGELECTRONICSCO.,LTD.:pnSQ45S70S:*:rnSQ45S70S:*");
+
+#ifdef CONFIG_SAMSUNG_BACKLIGHT_KUNIT_TEST
+#include "samsung-backlight-test.c"
+#endif
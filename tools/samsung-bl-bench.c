@@ -0,0 +1,363 @@
+/*
+ * Brightness write latency benchmark for the Samsung backlight driver
+ *
+ * Hammers the brightness file of one backlight from a number of threads, at
+ * a fixed rate or as fast as it goes, and reports the latency percentiles of
+ * the sysfs writes.  The driver's own debugfs files are read before and after
+ * the run, so the same report also breaks that down into the time spent in
+ * update_status() and in the config space writes underneath it, and follows
+ * the writes down from sysfs to the hardware.  The driver keeps log2
+ * histograms, so its percentiles are upper bounds, but the means are exact.
+ *
+ * Run it against the loopback backlights (load the driver with loopback=N)
+ * to try out a host without the hardware.  Needs root, and debugfs mounted
+ * for the in-driver numbers.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SYSFS_DIR	"/sys/class/backlight"
+#define DEBUGFS_DIR	"/sys/kernel/debug/samsung-backlight"
+#define BUCKETS		32
+#define NSEC_PER_SEC	1000000000ULL
+
+static const char *name = "samsung";
+static unsigned int threads = 1;
+static unsigned int rate;
+static unsigned int count = 1000;
+static unsigned int max_brightness;
+
+struct worker {
+	pthread_t		thread;
+	unsigned int		id;
+	unsigned long long	*latency;
+	int			error;
+};
+
+/* what the driver has to say, see stats_show() and write_latency_show() */
+struct driver_stats {
+	unsigned long	config_writes;
+	unsigned long	writes_skipped;
+	unsigned long	writes_absorbed;
+	unsigned long	writes_issued;
+	unsigned long	updates;
+	unsigned long long write_time;
+	unsigned long long update_time;
+	unsigned long	write_latency[BUCKETS];
+	unsigned long	update_latency[BUCKETS];
+	int		valid;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int read_uint(const char *file, unsigned int *value)
+{
+	char path[256];
+	FILE *f;
+	int retval;
+
+	snprintf(path, sizeof(path), SYSFS_DIR "/%s/%s", name, file);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	retval = fscanf(f, "%u", value) == 1 ? 0 : -EINVAL;
+	fclose(f);
+	return retval;
+}
+
+/* one of the latency histograms, returns 0 if it was all there */
+static int read_hist(const char *file, unsigned long *hist)
+{
+	char path[256];
+	char line[128];
+	unsigned long long bound;
+	unsigned long value;
+	int i = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), DEBUGFS_DIR "/%s/%s", name, file);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (i < BUCKETS && fgets(line, sizeof(line), f))
+		if (sscanf(line, "< %llu ns: %lu", &bound, &value) == 2)
+			hist[i++] = value;
+	fclose(f);
+	return i == BUCKETS ? 0 : -1;
+}
+
+static void read_driver_stats(struct driver_stats *s)
+{
+	char path[256];
+	char line[128];
+	FILE *f;
+
+	memset(s, 0, sizeof(*s));
+
+	snprintf(path, sizeof(path), DEBUGFS_DIR "/%s/stats", name);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		sscanf(line, "config_writes: %lu", &s->config_writes);
+		sscanf(line, "writes_skipped: %lu", &s->writes_skipped);
+		sscanf(line, "writes_absorbed: %lu", &s->writes_absorbed);
+		sscanf(line, "writes_issued: %lu", &s->writes_issued);
+		sscanf(line, "write_time_ns: %llu", &s->write_time);
+		sscanf(line, "updates: %lu", &s->updates);
+		sscanf(line, "update_time_ns: %llu", &s->update_time);
+	}
+	fclose(f);
+
+	s->valid = !read_hist("write_latency", s->write_latency) &&
+		   !read_hist("update_latency", s->update_latency);
+}
+
+static void *worker_run(void *data)
+{
+	struct worker *w = data;
+	unsigned long long start;
+	struct timespec next;
+	char path[256];
+	char buf[16];
+	unsigned int i;
+	int len;
+	int fd;
+
+	snprintf(path, sizeof(path), SYSFS_DIR "/%s/brightness", name);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		w->error = errno;
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < count; i++) {
+		if (rate) {
+			next.tv_nsec += NSEC_PER_SEC / rate;
+			while (next.tv_nsec >= (long)NSEC_PER_SEC) {
+				next.tv_nsec -= NSEC_PER_SEC;
+				next.tv_sec++;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&next, NULL);
+		}
+
+		/* every thread walks the levels from a different place */
+		len = snprintf(buf, sizeof(buf), "%u\n",
+			       (i + w->id) % (max_brightness + 1));
+		start = now_ns();
+		if (pwrite(fd, buf, len, 0) != len) {
+			w->error = errno;
+			break;
+		}
+		w->latency[i] = now_ns() - start;
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static int compare_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static unsigned long long percentile(const unsigned long long *sorted,
+				     size_t n, double p)
+{
+	size_t i = (size_t)(p * n + 0.999999);
+
+	return sorted[i ? i - 1 : 0];
+}
+
+/* upper bound of the log2 bucket the percentile falls in */
+static unsigned long long hist_percentile(const unsigned long *hist,
+					  unsigned long total, double p)
+{
+	unsigned long want = (unsigned long)(p * total + 0.999999);
+	unsigned long seen = 0;
+	int i;
+
+	for (i = 0; i < BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= want && seen)
+			return 1ULL << i;
+	}
+	return 1ULL << (BUCKETS - 1);
+}
+
+/* what the driver saw during the run, from one of its histograms */
+static void print_driver_latency(const char *what, const unsigned long *before,
+				 const unsigned long *after,
+				 unsigned long long time, unsigned long calls)
+{
+	unsigned long hist[BUCKETS];
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < BUCKETS; i++) {
+		hist[i] = after[i] - before[i];
+		total += hist[i];
+	}
+
+	printf("%s, from the driver:\n", what);
+	if (!total || !calls) {
+		printf("  none\n");
+		return;
+	}
+	printf("  p50 < %llu ns  p99 < %llu ns  p99.9 < %llu ns  mean %llu ns\n",
+	       hist_percentile(hist, total, 0.5),
+	       hist_percentile(hist, total, 0.99),
+	       hist_percentile(hist, total, 0.999), time / calls);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b backlight] [-t threads] [-r rate] [-n count]\n"
+		"  -b  backlight to drive (default: samsung)\n"
+		"  -t  number of threads writing at the same time (default: 1)\n"
+		"  -r  writes per second per thread, 0 = flat out (default: 0)\n"
+		"  -n  writes per thread (default: 1000)\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct driver_stats before, after;
+	unsigned long long update_time;
+	unsigned long long *all;
+	unsigned long long elapsed;
+	unsigned long long sum = 0;
+	unsigned long updates;
+	unsigned long writes;
+	struct worker *workers;
+	size_t n = 0;
+	unsigned int i, j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:t:r:n:")) != -1) {
+		switch (opt) {
+		case 'b':
+			name = optarg;
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!threads || !count)
+		usage(argv[0]);
+
+	if (read_uint("max_brightness", &max_brightness)) {
+		fprintf(stderr, "can not read " SYSFS_DIR "/%s/max_brightness\n",
+			name);
+		return 1;
+	}
+
+	workers = calloc(threads, sizeof(*workers));
+	all = calloc((size_t)threads * count, sizeof(*all));
+	if (!workers || !all) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	read_driver_stats(&before);
+	elapsed = now_ns();
+	for (i = 0; i < threads; i++) {
+		workers[i].id = i;
+		workers[i].latency = all + (size_t)i * count;
+		pthread_create(&workers[i].thread, NULL, worker_run,
+			       &workers[i]);
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	elapsed = now_ns() - elapsed;
+	read_driver_stats(&after);
+
+	/* squeeze out whatever a failed thread did not get to */
+	for (i = 0; i < threads; i++) {
+		if (workers[i].error)
+			fprintf(stderr, "thread %u: %s\n", i,
+				strerror(workers[i].error));
+		for (j = 0; j < count; j++) {
+			if (!workers[i].latency[j])
+				continue;
+			sum += workers[i].latency[j];
+			all[n++] = workers[i].latency[j];
+		}
+	}
+	if (!n) {
+		fprintf(stderr, "no writes made it\n");
+		return 1;
+	}
+	qsort(all, n, sizeof(*all), compare_ull);
+
+	printf("%zu writes from %u thread(s) in %llu ms, %llu writes/s\n",
+	       n, threads, elapsed / 1000000,
+	       n * NSEC_PER_SEC / (elapsed ? elapsed : 1));
+	printf("sysfs write, from userspace:\n");
+	printf("  p50 %llu ns  p99 %llu ns  p99.9 %llu ns  max %llu ns  mean %llu ns\n",
+	       percentile(all, n, 0.5), percentile(all, n, 0.99),
+	       percentile(all, n, 0.999), all[n - 1], sum / n);
+
+	if (!before.valid || !after.valid) {
+		printf("no driver statistics, is debugfs mounted?\n");
+		return 0;
+	}
+
+	updates = after.updates - before.updates;
+	update_time = after.update_time - before.update_time;
+	writes = after.config_writes - before.config_writes;
+	print_driver_latency("update_status()", before.update_latency,
+			     after.update_latency, update_time, updates);
+	print_driver_latency("config space write", before.write_latency,
+			     after.write_latency,
+			     after.write_time - before.write_time, writes);
+
+	printf("where the writes went:\n");
+	printf("  %zu sysfs writes, %lu update_status() calls, %lu config writes\n",
+	       n, updates, writes);
+	printf("  %lu skipped as unchanged, %lu coalesced writes issued, %lu absorbed\n",
+	       after.writes_skipped - before.writes_skipped,
+	       after.writes_issued - before.writes_issued,
+	       after.writes_absorbed - before.writes_absorbed);
+	/* only when every update_status() call was one of ours */
+	if (updates != n)
+		printf("  the counts do not match, something else was writing\n");
+	else if (sum > update_time)
+		printf("  sysfs and backlight core: %llu ns per write on top\n",
+		       (sum - update_time) / n);
+	return 0;
+}
@@ -0,0 +1,1036 @@
+/*
+ * Just enough of the kernel to build samsung-backlight.c in userspace
+ *
+ * The driver source is compiled as is, see samsung-bl-shim.c, the kernel
+ * headers it includes are empty files made up by the Makefile and everything
+ * it uses from them lives in here instead.  The parts that matter for the
+ * register paths behave like the real thing:
+ *
+ *  - spinlocks and mutexes are pthread mutexes, per-cpu data is a single copy
+ *    updated atomically
+ *  - there is one fake PCI device, 8086:27ae like on the N130 and NC10, with
+ *    256 bytes of config space behind pci_read_config_byte() and
+ *    pci_write_config_byte(), which count every access
+ *  - the DMI strings are those of an NC10, or whatever the SHIM_DMI_VENDOR,
+ *    SHIM_DMI_PRODUCT and SHIM_DMI_BOARD environment variables say
+ *  - registering the platform driver and device probes right away, and
+ *    backlight_device_register() and backlight_device_set_brightness() do
+ *    what the backlight core does, locking included
+ *
+ * Everything else is a stub.  Timers and work items are only marked pending
+ * and never run, so the fade and coalescing paths have to be turned off,
+ * flush_delayed_work() runs a pending one in the caller.  There is no sysfs,
+ * debugfs, input, IIO, power supply or firmware loading, and tracepoints are
+ * compiled out.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#ifndef _SAMSUNG_BL_SHIM_KERNEL_H
+#define _SAMSUNG_BL_SHIM_KERNEL_H
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KERNEL_VERSION(a, b, c)	(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE	KERNEL_VERSION(6, 1, 0)
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u16 __le16;
+typedef u32 __le32;
+typedef s64 ktime_t;
+typedef unsigned int gfp_t;
+typedef unsigned short umode_t;
+
+#define S_IRUGO			(S_IRUSR | S_IRGRP | S_IROTH)
+
+#define __init
+#define __initdata
+#define __exit
+#define __percpu
+#define __packed		__attribute__((packed))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define READ_ONCE(x)		(*(const volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile typeof(x) *)&(x) = (val))
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member)	\
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		min((t)(a), (t)(b))
+#define max_t(t, a, b)		max((t)(a), (t)(b))
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define DIV_ROUND_CLOSEST(n, d)	(((n) + (d) / 2) / (d))
+
+#define le16_to_cpu(x)		((u16)(x))
+#define le32_to_cpu(x)		((u32)(x))
+
+static inline int fls64(u64 x)
+{
+	return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+#define BIT_MASK(nr)		(1UL << ((nr) % (8 * sizeof(long))))
+#define BIT_WORD(nr)		((nr) / (8 * sizeof(long)))
+
+static inline bool test_bit(long nr, const unsigned long *addr)
+{
+	return addr[BIT_WORD(nr)] & BIT_MASK(nr);
+}
+
+/* errors */
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error)
+{
+	return (void *)error;
+}
+
+static inline long PTR_ERR(const void *ptr)
+{
+	return (long)ptr;
+}
+
+static inline bool IS_ERR(const void *ptr)
+{
+	return IS_ERR_VALUE(ptr);
+}
+
+static inline bool IS_ERR_OR_NULL(const void *ptr)
+{
+	return !ptr || IS_ERR_VALUE(ptr);
+}
+
+/* printk and friends */
+#define KERN_ERR		"<3>"
+#define KERN_WARNING		"<4>"
+#define KERN_INFO		"<6>"
+#define KERN_DEBUG		"<7>"
+/* set to keep the driver quiet, say while loading it over and over */
+static bool shim_quiet;
+
+#define printk(fmt, ...)						\
+	(shim_quiet ? 0 : fprintf(stderr, fmt, ##__VA_ARGS__))
+
+/* memory */
+#define GFP_KERNEL		0
+
+static inline void *kmalloc(size_t size, gfp_t flags)
+{
+	return malloc(size);
+}
+
+static inline void *kzalloc(size_t size, gfp_t flags)
+{
+	return calloc(1, size);
+}
+
+static inline void *kmemdup(const void *src, size_t len, gfp_t flags)
+{
+	void *p = malloc(len);
+
+	if (p)
+		memcpy(p, src, len);
+	return p;
+}
+
+static inline void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+/* string parsing, near enough to the kernel's for module parameters */
+static inline int kstrtoll_shim(const char *s, unsigned int base,
+				long long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoll(s, &end, base);
+	if (errno)
+		return -ERANGE;
+	if (end == s)
+		return -EINVAL;
+	if (*end == '\n')
+		end++;
+	return *end ? -EINVAL : 0;
+}
+
+static inline int kstrtoint(const char *s, unsigned int base, int *res)
+{
+	long long v;
+	int retval = kstrtoll_shim(s, base, &v);
+
+	if (retval)
+		return retval;
+	if (v != (int)v)
+		return -ERANGE;
+	*res = v;
+	return 0;
+}
+
+static inline int kstrtouint(const char *s, unsigned int base,
+			     unsigned int *res)
+{
+	long long v;
+	int retval = kstrtoll_shim(s, base, &v);
+
+	if (retval)
+		return retval;
+	if (v < 0 || v != (unsigned int)v)
+		return -ERANGE;
+	*res = v;
+	return 0;
+}
+
+/* time */
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_MSEC		1000000L
+#define NSEC_PER_SEC		1000000000L
+#define HZ			250
+
+static inline ktime_t ktime_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ktime_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+#define ktime_set(s, ns)	((ktime_t)(s) * NSEC_PER_SEC + (ns))
+#define ktime_add(a, b)		((a) + (b))
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_add_ms(kt, ms)	((kt) + (ktime_t)(ms) * NSEC_PER_MSEC)
+#define ktime_to_ns(kt)		((s64)(kt))
+#define ns_to_ktime(ns)		((ktime_t)(ns))
+#define ms_to_ktime(ms)		((ktime_t)(ms) * NSEC_PER_MSEC)
+#define ktime_before(a, b)	((a) < (b))
+#define ktime_after(a, b)	((a) > (b))
+#define ktime_compare(a, b)	((a) < (b) ? -1 : (a) > (b))
+
+#define jiffies			((unsigned long)(ktime_get() / (NSEC_PER_SEC / HZ)))
+#define msecs_to_jiffies(ms)	((unsigned long)DIV_ROUND_UP((ms) * HZ, 1000))
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+
+static inline void ndelay(unsigned long ns)
+{
+	ktime_t end = ktime_get() + ns;
+
+	while (ktime_get() < end)
+		;
+}
+
+/* locking */
+typedef struct {
+	pthread_mutex_t		lock;
+} spinlock_t;
+
+struct mutex {
+	pthread_mutex_t		lock;
+};
+
+#define DEFINE_SPINLOCK(name)	spinlock_t name = { PTHREAD_MUTEX_INITIALIZER }
+#define DEFINE_MUTEX(name)	struct mutex name = { PTHREAD_MUTEX_INITIALIZER }
+
+#define spin_lock_init(l)	pthread_mutex_init(&(l)->lock, NULL)
+#define spin_lock(l)		pthread_mutex_lock(&(l)->lock)
+#define spin_unlock(l)		pthread_mutex_unlock(&(l)->lock)
+#define spin_lock_irq(l)	spin_lock(l)
+#define spin_unlock_irq(l)	spin_unlock(l)
+#define spin_lock_irqsave(l, flags)	\
+	do { (flags) = 0; spin_lock(l); } while (0)
+#define spin_unlock_irqrestore(l, flags)	\
+	do { (void)(flags); spin_unlock(l); } while (0)
+
+#define mutex_init(m)		pthread_mutex_init(&(m)->lock, NULL)
+#define mutex_lock(m)		pthread_mutex_lock(&(m)->lock)
+#define mutex_unlock(m)		pthread_mutex_unlock(&(m)->lock)
+
+typedef struct {
+	int			counter;
+} atomic_t;
+
+#define atomic_set(v, i)	__atomic_store_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic_read(v)		__atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define atomic_add(i, v)	__atomic_fetch_add(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic_xchg(v, i)	__atomic_exchange_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+
+/* per-cpu data, a single copy */
+#define alloc_percpu(type)	((type *)calloc(1, sizeof(type)))
+#define free_percpu(p)		free(p)
+#define per_cpu_ptr(p, cpu)	((void)(cpu), (p))
+#define for_each_possible_cpu(cpu)	for ((cpu) = 0; (cpu) < 1; (cpu)++)
+#define this_cpu_add(x, v)	__atomic_fetch_add(&(x), v, __ATOMIC_RELAXED)
+#define this_cpu_inc(x)		this_cpu_add(x, 1)
+
+/* lists */
+struct list_head {
+	struct list_head	*next, *prev;
+};
+
+#define LIST_HEAD(name)		struct list_head name = { &(name), &(name) }
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head)
+{
+	new->prev = head->prev;
+	new->next = head;
+	head->prev->next = new;
+	head->prev = new;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = entry->prev = NULL;
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+#define list_last_entry(head, type, member)	\
+	list_entry((head)->prev, type, member)
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = list_entry((head)->next, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = list_entry(pos->member.next, typeof(*pos), member))
+#define list_for_each_entry_safe(pos, n, head, member)			\
+	for (pos = list_entry((head)->next, typeof(*pos), member),	\
+	     n = list_entry(pos->member.next, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = n, n = list_entry(n->member.next, typeof(*n), member))
+
+/* timers and work, never run, see the top of the file */
+enum hrtimer_restart {
+	HRTIMER_NORESTART,
+	HRTIMER_RESTART,
+};
+
+enum hrtimer_mode {
+	HRTIMER_MODE_ABS,
+	HRTIMER_MODE_REL,
+	HRTIMER_MODE_ABS_SOFT,
+	HRTIMER_MODE_REL_SOFT,
+};
+
+struct hrtimer {
+	enum hrtimer_restart	(*function)(struct hrtimer *);
+	bool			active;
+};
+
+#define hrtimer_init(t, clock, mode)	((t)->active = false)
+#define hrtimer_start(t, tim, mode)	((t)->active = true)
+#define hrtimer_active(t)		READ_ONCE((t)->active)
+#define hrtimer_forward_now(t, interval)	((void)(interval))
+#define hrtimer_set_expires(t, time)	((void)(time))
+
+static inline int hrtimer_cancel(struct hrtimer *timer)
+{
+	bool was = timer->active;
+
+	timer->active = false;
+	return was;
+}
+
+struct work_struct {
+	void			(*func)(struct work_struct *);
+	bool			pending;
+};
+
+struct delayed_work {
+	struct work_struct	work;
+};
+
+#define INIT_WORK(w, f)		((w)->func = (f), (w)->pending = false)
+#define INIT_DELAYED_WORK(w, f)	INIT_WORK(&(w)->work, f)
+#define INIT_DEFERRABLE_WORK(w, f)	INIT_DELAYED_WORK(w, f)
+#define to_delayed_work(w)	container_of(w, struct delayed_work, work)
+
+#define system_wq		NULL
+#define system_highpri_wq	NULL
+#define system_power_efficient_wq	NULL
+
+static inline bool shim_queue(struct work_struct *work)
+{
+	bool was = work->pending;
+
+	work->pending = true;
+	return !was;
+}
+
+static inline bool shim_cancel(struct work_struct *work)
+{
+	bool was = work->pending;
+
+	work->pending = false;
+	return was;
+}
+
+static inline bool shim_queue_delayed(struct delayed_work *dwork,
+				      unsigned long delay)
+{
+	return shim_queue(&dwork->work);
+}
+
+#define schedule_work(w)		shim_queue(w)
+#define queue_work(wq, w)		shim_queue(w)
+#define schedule_delayed_work(w, d)	shim_queue_delayed(w, d)
+#define queue_delayed_work(wq, w, d)	shim_queue_delayed(w, d)
+#define mod_delayed_work(wq, w, d)	shim_queue_delayed(w, d)
+#define delayed_work_pending(w)		((w)->work.pending)
+#define cancel_work_sync(w)		shim_cancel(w)
+#define cancel_delayed_work_sync(w)	shim_cancel(&(w)->work)
+
+static inline bool flush_delayed_work(struct delayed_work *dwork)
+{
+	if (!shim_cancel(&dwork->work))
+		return false;
+	dwork->work.func(&dwork->work);
+	return true;
+}
+
+/* the current task, there is only ever the one */
+#define TASK_COMM_LEN		16
+
+struct task_struct {
+	pid_t			pid;
+	char			comm[TASK_COMM_LEN];
+};
+
+static struct task_struct shim_task = { 1, "shim" };
+
+#define current			(&shim_task)
+#define task_pid_nr(t)		((t)->pid)
+#define get_task_comm(buf, t)	strcpy(buf, (t)->comm)
+
+/* modules and their parameters */
+#define KBUILD_MODNAME		"samsung_backlight"
+#define THIS_MODULE		NULL
+
+struct kernel_param {
+	const char		*name;
+	void			*arg;
+};
+
+struct kernel_param_ops {
+	int (*set)(const char *val, const struct kernel_param *kp);
+	int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+static inline int param_get_int(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%d\n", *(int *)kp->arg);
+}
+
+static inline int param_get_uint(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%u\n", *(unsigned int *)kp->arg);
+}
+
+/* the parameters are plain variables, set them before module_init */
+#define module_param(name, type, perm)
+#define module_param_cb(name, ops, arg, perm)				\
+	static const struct kernel_param_ops *__shim_param_##name	\
+		__attribute__((unused)) = (ops)
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define MODULE_ALIAS(x)
+#define MODULE_FIRMWARE(x)
+
+#define module_init(fn)		int shim_module_init(void) { return fn(); }
+#define module_exit(fn)		void shim_module_exit(void) { fn(); }
+
+/* the driver core, as far as we need it */
+struct kobject {
+	const char		*name;
+};
+
+struct attribute {
+	const char		*name;
+	umode_t			mode;
+};
+
+struct device;
+
+struct device_attribute {
+	struct attribute	attr;
+	ssize_t (*show)(struct device *dev, struct device_attribute *attr,
+			char *buf);
+	ssize_t (*store)(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count);
+};
+
+#define DEVICE_ATTR(_name, _mode, _show, _store)			\
+	struct device_attribute dev_attr_##_name = {			\
+		{ #_name, _mode }, _show, _store			\
+	}
+
+struct file;
+
+struct bin_attribute {
+	struct attribute	attr;
+	size_t			size;
+	ssize_t (*read)(struct file *, struct kobject *,
+			struct bin_attribute *, char *, loff_t, size_t);
+	ssize_t (*write)(struct file *, struct kobject *,
+			 struct bin_attribute *, char *, loff_t, size_t);
+};
+
+#define BIN_ATTR(_name, _mode, _read, _write, _size)			\
+	struct bin_attribute bin_attr_##_name = {			\
+		{ #_name, _mode }, _size, _read, _write			\
+	}
+
+struct attribute_group {
+	struct attribute	**attrs;
+	struct bin_attribute	**bin_attrs;
+};
+
+#define sysfs_create_group(kobj, grp)	0
+#define sysfs_remove_group(kobj, grp)	do { } while (0)
+#define sysfs_notify(kobj, dir, attr)	do { } while (0)
+
+enum kobject_action {
+	KOBJ_CHANGE,
+};
+
+static inline int kobject_uevent_env(struct kobject *kobj,
+				     enum kobject_action action, char *envp[])
+{
+	return 0;
+}
+
+struct dev_pm_ops {
+	int (*suspend)(struct device *dev);
+	int (*resume)(struct device *dev);
+	int (*freeze)(struct device *dev);
+	int (*thaw)(struct device *dev);
+	int (*poweroff)(struct device *dev);
+	int (*restore)(struct device *dev);
+};
+
+#define PROBE_PREFER_ASYNCHRONOUS	1
+
+struct device_driver {
+	const char		*name;
+	void			*owner;
+	const struct dev_pm_ops	*pm;
+	int			probe_type;
+};
+
+struct device {
+	struct kobject		kobj;
+	char			name[32];
+	void			*driver_data;
+};
+
+#define kobj_to_dev(k)		container_of(k, struct device, kobj)
+#define dev_name(dev)		((const char *)(dev)->name)
+#define dev_get_drvdata(dev)	((dev)->driver_data)
+#define dev_set_drvdata(dev, data)	((dev)->driver_data = (data))
+#define device_enable_async_suspend(dev)	do { } while (0)
+#define wait_for_device_probe()	do { } while (0)
+
+struct device_link {
+	struct device		*consumer;
+	struct device		*supplier;
+};
+
+#define DL_FLAG_STATELESS	1
+
+static inline struct device_link *device_link_add(struct device *consumer,
+						  struct device *supplier,
+						  u32 flags)
+{
+	struct device_link *link = calloc(1, sizeof(*link));
+
+	if (link) {
+		link->consumer = consumer;
+		link->supplier = supplier;
+	}
+	return link;
+}
+
+#define device_link_del(link)	free(link)
+
+/* platform bus, binding is done as soon as both ends are registered */
+struct resource;
+
+struct platform_device {
+	struct device		dev;
+	const char		*name;
+	int			id;
+};
+
+struct platform_driver {
+	int (*probe)(struct platform_device *);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+	void (*remove)(struct platform_device *);
+#else
+	int (*remove)(struct platform_device *);
+#endif
+	struct device_driver	driver;
+};
+
+static struct platform_driver *shim_platform_driver;
+static struct platform_device *shim_platform_device;
+static bool shim_platform_bound;
+
+static inline void shim_platform_bind(void)
+{
+	struct platform_driver *drv = shim_platform_driver;
+	struct platform_device *pdev = shim_platform_device;
+
+	if (!drv || !pdev || shim_platform_bound ||
+	    strcmp(drv->driver.name, pdev->name))
+		return;
+	shim_platform_bound = !drv->probe(pdev);
+}
+
+static inline void shim_platform_unbind(void)
+{
+	if (shim_platform_bound)
+		shim_platform_driver->remove(shim_platform_device);
+	shim_platform_bound = false;
+}
+
+static inline int platform_driver_register(struct platform_driver *drv)
+{
+	shim_platform_driver = drv;
+	shim_platform_bind();
+	return 0;
+}
+
+static inline void platform_driver_unregister(struct platform_driver *drv)
+{
+	shim_platform_unbind();
+	shim_platform_driver = NULL;
+}
+
+static inline struct platform_device *
+platform_device_register_simple(const char *name, int id,
+				const struct resource *res, unsigned int num)
+{
+	struct platform_device *pdev = calloc(1, sizeof(*pdev));
+
+	if (!pdev)
+		return ERR_PTR(-ENOMEM);
+	pdev->name = name;
+	pdev->id = id;
+	snprintf(pdev->dev.name, sizeof(pdev->dev.name), "%s", name);
+	shim_platform_device = pdev;
+	shim_platform_bind();
+	return pdev;
+}
+
+static inline void platform_device_unregister(struct platform_device *pdev)
+{
+	shim_platform_unbind();
+	shim_platform_device = NULL;
+	free(pdev);
+}
+
+/* PCI, one fake device with a config space that counts its accesses */
+#define PCI_VENDOR_ID_INTEL	0x8086
+#define PCI_ANY_ID		(~0)
+#define PCI_DEVICE(vend, dev)						\
+	.vendor = (vend), .device = (dev),				\
+	.subvendor = PCI_ANY_ID, .subdevice = PCI_ANY_ID
+
+struct pci_device_id {
+	u32			vendor, device;
+	u32			subvendor, subdevice;
+	u32			class, class_mask;
+	unsigned long		driver_data;
+};
+
+struct pci_dev {
+	struct device		dev;
+	u16			vendor;
+	u16			device;
+	u8			config[256];
+	unsigned long		config_reads;
+	unsigned long		config_writes;
+	unsigned int		delay_ns;
+	int			refcount;
+};
+
+static struct pci_dev shim_pci_dev = {
+	.dev		= { .name = "0000:00:02.0" },
+	.vendor		= PCI_VENDOR_ID_INTEL,
+	.device		= 0x27ae,
+	/* what the BIOS leaves at the usual brightness register */
+	.config		= { [0xf4] = 0xff },
+};
+
+static inline struct pci_dev *pci_get_device(unsigned int vendor,
+					     unsigned int device,
+					     struct pci_dev *from)
+{
+	struct pci_dev *dev = &shim_pci_dev;
+
+	if (from) {
+		from->refcount--;
+		return NULL;
+	}
+	if ((vendor != PCI_ANY_ID && vendor != dev->vendor) ||
+	    (device != PCI_ANY_ID && device != dev->device))
+		return NULL;
+	dev->refcount++;
+	return dev;
+}
+
+static inline struct pci_dev *pci_dev_get(struct pci_dev *dev)
+{
+	if (dev)
+		dev->refcount++;
+	return dev;
+}
+
+static inline void pci_dev_put(struct pci_dev *dev)
+{
+	if (dev)
+		dev->refcount--;
+}
+
+static inline int pci_read_config_byte(const struct pci_dev *dev, int where,
+				       u8 *val)
+{
+	struct pci_dev *d = (struct pci_dev *)dev;
+
+	if (d->delay_ns)
+		ndelay(d->delay_ns);
+	__atomic_fetch_add(&d->config_reads, 1, __ATOMIC_RELAXED);
+	*val = READ_ONCE(d->config[where]);
+	return 0;
+}
+
+static inline int pci_write_config_byte(const struct pci_dev *dev, int where,
+					u8 val)
+{
+	struct pci_dev *d = (struct pci_dev *)dev;
+
+	if (d->delay_ns)
+		ndelay(d->delay_ns);
+	__atomic_fetch_add(&d->config_writes, 1, __ATOMIC_RELAXED);
+	WRITE_ONCE(d->config[where], val);
+	return 0;
+}
+
+/* DMI, an NC10 unless the environment says otherwise */
+enum dmi_field {
+	DMI_NONE,
+	DMI_SYS_VENDOR,
+	DMI_PRODUCT_NAME,
+	DMI_BOARD_NAME,
+	DMI_STRING_MAX,
+};
+
+struct dmi_strmatch {
+	unsigned char		slot;
+	char			substr[79];
+};
+
+struct dmi_system_id {
+	int (*callback)(const struct dmi_system_id *);
+	const char		*ident;
+	struct dmi_strmatch	matches[4];
+	void			*driver_data;
+};
+
+#define DMI_MATCH(a, b)		{ .slot = a, .substr = b }
+
+static inline const char *dmi_get_system_info(int field)
+{
+	static const char *const env[DMI_STRING_MAX] = {
+		[DMI_SYS_VENDOR]	= "SHIM_DMI_VENDOR",
+		[DMI_PRODUCT_NAME]	= "SHIM_DMI_PRODUCT",
+		[DMI_BOARD_NAME]	= "SHIM_DMI_BOARD",
+	};
+	static const char *const nc10[DMI_STRING_MAX] = {
+		[DMI_SYS_VENDOR]	= "SAMSUNG ELECTRONICS CO., LTD.",
+		[DMI_PRODUCT_NAME]	= "NC10",
+		[DMI_BOARD_NAME]	= "NC10",
+	};
+	const char *value;
+
+	if (field <= DMI_NONE || field >= DMI_STRING_MAX)
+		return NULL;
+	value = getenv(env[field]);
+	return value ? value : nc10[field];
+}
+
+static inline bool dmi_match(enum dmi_field f, const char *str)
+{
+	const char *value = dmi_get_system_info(f);
+
+	return value && !strcmp(value, str);
+}
+
+static inline int dmi_check_system(const struct dmi_system_id *list)
+{
+	const struct dmi_system_id *d;
+	const char *value;
+	int count = 0;
+	int i;
+
+	for (d = list; d->matches[0].slot; d++) {
+		for (i = 0; i < ARRAY_SIZE(d->matches); i++) {
+			if (!d->matches[i].slot)
+				continue;
+			value = dmi_get_system_info(d->matches[i].slot);
+			if (!value || !strstr(value, d->matches[i].substr))
+				break;
+		}
+		if (i < ARRAY_SIZE(d->matches))
+			continue;
+		count++;
+		if (d->callback && d->callback(d))
+			break;
+	}
+	return count;
+}
+
+/* the backlight class, what the core does on a sysfs brightness write */
+#define FB_BLANK_UNBLANK	0
+
+enum backlight_update_reason {
+	BACKLIGHT_UPDATE_HOTKEY,
+	BACKLIGHT_UPDATE_SYSFS,
+};
+
+struct backlight_properties {
+	int			brightness;
+	int			max_brightness;
+	int			power;
+};
+
+struct backlight_device;
+
+struct backlight_ops {
+	int (*update_status)(struct backlight_device *);
+	int (*get_brightness)(struct backlight_device *);
+};
+
+struct backlight_device {
+	struct backlight_properties props;
+	struct mutex		update_lock;
+	struct mutex		ops_lock;
+	const struct backlight_ops *ops;
+	struct device		dev;
+};
+
+#define to_backlight_device(d)	container_of(d, struct backlight_device, dev)
+#define bl_get_data(bd)		dev_get_drvdata(&(bd)->dev)
+
+static inline struct backlight_device *
+backlight_device_register(const char *name, struct device *parent,
+			  void *devdata, const struct backlight_ops *ops,
+			  const struct backlight_properties *props)
+{
+	struct backlight_device *bd = calloc(1, sizeof(*bd));
+
+	if (!bd)
+		return ERR_PTR(-ENOMEM);
+	snprintf(bd->dev.name, sizeof(bd->dev.name), "%s", name);
+	bd->dev.kobj.name = bd->dev.name;
+	dev_set_drvdata(&bd->dev, devdata);
+	mutex_init(&bd->update_lock);
+	mutex_init(&bd->ops_lock);
+	bd->ops = ops;
+	bd->props = *props;
+	return bd;
+}
+
+static inline void backlight_device_unregister(struct backlight_device *bd)
+{
+	free(bd);
+}
+
+static inline int backlight_update_status(struct backlight_device *bd)
+{
+	int retval;
+
+	mutex_lock(&bd->update_lock);
+	retval = bd->ops->update_status(bd);
+	mutex_unlock(&bd->update_lock);
+	return retval;
+}
+
+static inline int backlight_device_set_brightness(struct backlight_device *bd,
+						  unsigned long brightness)
+{
+	int retval = -ENXIO;
+
+	mutex_lock(&bd->ops_lock);
+	if (bd->ops) {
+		if (brightness > bd->props.max_brightness) {
+			retval = -EINVAL;
+		} else {
+			bd->props.brightness = brightness;
+			retval = backlight_update_status(bd);
+		}
+	}
+	mutex_unlock(&bd->ops_lock);
+	return retval;
+}
+
+/* debugfs and seq_file, nothing gets created but show functions work */
+struct dentry;
+struct inode;
+
+struct seq_file {
+	FILE			*file;
+	void			*private;
+};
+
+#define seq_printf(m, fmt, ...)	fprintf((m)->file, fmt, ##__VA_ARGS__)
+
+struct file_operations {
+	int (*show)(struct seq_file *, void *);
+};
+
+#define DEFINE_SHOW_ATTRIBUTE(name)					\
+	static const struct file_operations name##_fops = {		\
+		.show = name##_show,					\
+	}
+
+static inline struct dentry *debugfs_create_dir(const char *name,
+						struct dentry *parent)
+{
+	return NULL;
+}
+
+static inline struct dentry *
+debugfs_create_file(const char *name, umode_t mode, struct dentry *parent,
+		    void *data, const struct file_operations *fops)
+{
+	return NULL;
+}
+
+#define debugfs_remove_recursive(dentry)	do { } while (0)
+
+/* firmware loading, there never is a file */
+struct firmware {
+	size_t			size;
+	const u8		*data;
+};
+
+#define firmware_request_nowarn(fw, name, dev)	(-ENOENT)
+#define release_firmware(fw)			do { } while (0)
+
+/* input, IIO and power supplies, none of them there */
+#define EV_KEY			0x01
+#define KEY_SPACE		57
+#define KEY_BRIGHTNESSDOWN	224
+#define KEY_BRIGHTNESSUP	225
+#define BTN_LEFT		0x110
+#define BTN_TOUCH		0x14a
+#define KEY_MAX			0x2ff
+#define INPUT_DEVICE_ID_MATCH_EVBIT	0x0010
+#define INPUT_DEVICE_ID_MATCH_KEYBIT	0x0020
+
+struct input_dev {
+	unsigned long		keybit[BIT_WORD(KEY_MAX) + 1];
+};
+
+struct input_device_id {
+	unsigned long		flags;
+	unsigned long		evbit[1];
+	unsigned long		keybit[BIT_WORD(KEY_MAX) + 1];
+};
+
+struct input_handler;
+
+struct input_handle {
+	struct input_dev	*dev;
+	struct input_handler	*handler;
+	const char		*name;
+};
+
+struct input_handler {
+	void (*event)(struct input_handle *, unsigned int, unsigned int, int);
+	bool (*match)(struct input_handler *, struct input_dev *);
+	int (*connect)(struct input_handler *, struct input_dev *,
+		       const struct input_device_id *);
+	void (*disconnect)(struct input_handle *);
+	const char		*name;
+	const struct input_device_id *id_table;
+};
+
+static inline int input_register_handler(struct input_handler *handler)
+{
+	return 0;
+}
+
+#define input_unregister_handler(h)	do { } while (0)
+#define input_register_handle(h)	0
+#define input_unregister_handle(h)	do { } while (0)
+#define input_open_device(h)		0
+#define input_close_device(h)		do { } while (0)
+
+struct iio_channel;
+
+#define iio_channel_get(dev, name)	((struct iio_channel *)ERR_PTR(-ENODEV))
+#define iio_channel_release(chan)	do { } while (0)
+#define iio_read_channel_processed(chan, val)	(-ENODEV)
+
+struct notifier_block {
+	int (*notifier_call)(struct notifier_block *, unsigned long, void *);
+};
+
+#define NOTIFY_OK			0x0001
+#define PSY_EVENT_PROP_CHANGED		0
+static inline int power_supply_reg_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+
+#define power_supply_unreg_notifier(nb)	do { } while (0)
+#define power_supply_is_system_supplied()	1
+
+/* tracepoints, compiled out */
+#define TP_PROTO(args...)	args
+#define TP_ARGS(args...)	args
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args)			\
+	static inline void trace_##name(proto) { }			\
+	static inline bool trace_##name##_enabled(void) { return false; }
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)		\
+	DEFINE_EVENT(name, name, PARAMS(proto), PARAMS(args))
+#define PARAMS(args...)		args
+
+#endif /* _SAMSUNG_BL_SHIM_KERNEL_H */
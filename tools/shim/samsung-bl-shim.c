@@ -0,0 +1,233 @@
+/*
+ * Userspace benchmark of the Samsung backlight driver's register paths
+ *
+ * Builds samsung-backlight.c unmodified on top of kernel.h, loads it against
+ * a fake NC10 and times the paths between the backlight core and the
+ * brightness register: reading the level with and without the shadow
+ * register, get_brightness(), set_brightness() with the same and with a new
+ * level, update_status() the way a sysfs write gets there, and a whole
+ * module load and unload.  For every one it reports the latency per call and
+ * how many config space reads and writes a call took.  It runs once on the
+ * fake PCI device and once on a loopback backlight, no hardware or root
+ * needed.
+ *
+ * Every call is timed on its own, so the numbers include the cost of reading
+ * the clock, which is printed first to compare against.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#include "kernel.h"
+#include "../../samsung-backlight.c"
+
+static unsigned int count = 100000;
+static u64 *samples;
+
+struct bench_op {
+	const char	*name;
+	void		(*run)(struct samsung_bl *bl, unsigned int i);
+	unsigned int	calls;		/* 0 is every one */
+};
+
+static void op_clock(struct samsung_bl *bl, unsigned int i)
+{
+}
+
+static void op_read_cached(struct samsung_bl *bl, unsigned int i)
+{
+	read_brightness(bl);
+}
+
+static void op_read_uncached(struct samsung_bl *bl, unsigned int i)
+{
+	invalidate_hw(bl);
+	read_brightness(bl);
+}
+
+static void op_get_brightness(struct samsung_bl *bl, unsigned int i)
+{
+	bl->bd->ops->get_brightness(bl->bd);
+}
+
+static void op_set_same(struct samsung_bl *bl, unsigned int i)
+{
+	set_brightness(bl, 1);
+}
+
+static void op_set_new(struct samsung_bl *bl, unsigned int i)
+{
+	set_brightness(bl, i % levels);
+}
+
+static void op_update_status(struct samsung_bl *bl, unsigned int i)
+{
+	backlight_device_set_brightness(bl->bd, i % levels);
+}
+
+static const struct bench_op bench_ops[] = {
+	{ "clock only",			op_clock },
+	{ "read, shadow valid",		op_read_cached },
+	{ "read, shadow dropped",	op_read_uncached },
+	{ "get_brightness()",		op_get_brightness },
+	{ "set_brightness(), same",	op_set_same },
+	{ "set_brightness(), new",	op_set_new },
+	{ "update_status() via core",	op_update_status },
+};
+
+static int compare_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, unsigned int n, unsigned long reads,
+		   unsigned long writes)
+{
+	u64 sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+	qsort(samples, n, sizeof(*samples), compare_u64);
+
+	printf("  %-26s %8llu %8llu %8llu %9.2f %9.2f\n", name,
+	       (unsigned long long)(sum / n),
+	       (unsigned long long)samples[n / 2],
+	       (unsigned long long)samples[n - 1 - n / 100],
+	       (double)reads / n, (double)writes / n);
+}
+
+static struct samsung_bl *first_bl(void)
+{
+	if (samsung_devices.next == &samsung_devices)
+		return NULL;
+	return list_entry(samsung_devices.next, struct samsung_bl, list);
+}
+
+static int run_backend(const char *backend)
+{
+	const struct bench_op *op;
+	struct samsung_bl *bl;
+	unsigned long reads, writes;
+	unsigned int i, n;
+	ktime_t start;
+	int retval;
+
+	retval = shim_module_init();
+	if (retval) {
+		fprintf(stderr, "module init failed: %s\n", strerror(-retval));
+		return retval;
+	}
+	bl = first_bl();
+	if (!bl) {
+		fprintf(stderr, "no backlight got created, not a known model?\n");
+		shim_module_exit();
+		return -ENODEV;
+	}
+
+	printf("%s backend, %s, offset 0x%02x, %u levels\n", backend,
+	       dev_name(&bl->bd->dev), bl->offset, levels);
+	printf("  %-26s %8s %8s %8s %9s %9s\n", "", "mean ns", "p50 ns",
+	       "p99 ns", "reads", "writes");
+
+	for (op = bench_ops; op < bench_ops + ARRAY_SIZE(bench_ops); op++) {
+		n = op->calls ? op->calls : count;
+		set_brightness(bl, 1);
+		reads = stat_read(bl, config_reads);
+		writes = stat_read(bl, config_writes);
+		for (i = 0; i < n; i++) {
+			start = ktime_get();
+			op->run(bl, i);
+			samples[i] = ktime_to_ns(ktime_sub(ktime_get(), start));
+		}
+		report(op->name, n, stat_read(bl, config_reads) - reads,
+		       stat_read(bl, config_writes) - writes);
+	}
+
+	/*
+	 * Last, as it takes the backlight we were using away.  Only the PCI
+	 * side can be counted across that.
+	 */
+	n = max(count / 1000, 1U);
+	reads = shim_pci_dev.config_reads;
+	writes = shim_pci_dev.config_writes;
+	shim_quiet = true;
+	for (i = 0; i < n; i++) {
+		start = ktime_get();
+		shim_module_exit();
+		retval = shim_module_init();
+		samples[i] = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (retval) {
+			fprintf(stderr, "module init failed: %s\n",
+				strerror(-retval));
+			return retval;
+		}
+	}
+	shim_quiet = false;
+	report("module unload + load", n, shim_pci_dev.config_reads - reads,
+	       shim_pci_dev.config_writes - writes);
+
+	shim_module_exit();
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n count] [-d delay]\n"
+		"  -n  calls per operation (default: 100000)\n"
+		"  -d  extra nanoseconds every register access takes (default: 0)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int delay = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			delay = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!count)
+		usage(argv[0]);
+
+	samples = calloc(count, sizeof(*samples));
+	if (!samples) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	/* every write goes straight to the register, timers never fire here */
+	ramp_ms = 0;
+	coalesce_ms = 0;
+	shim_pci_dev.delay_ns = delay;
+
+	if (run_backend("pci"))
+		return 1;
+	printf("  pci config space: %lu reads, %lu writes in all\n",
+	       shim_pci_dev.config_reads, shim_pci_dev.config_writes);
+
+#ifdef CONFIG_SAMSUNG_BACKLIGHT_LOOPBACK
+	printf("\n");
+	loopback = 1;
+	loopback_delay_ns = min(delay, LOOPBACK_MAX_DELAY_NS);
+	if (run_backend("loopback"))
+		return 1;
+#endif
+	return 0;
+}